@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# animconv.py
+#
+# Конвертер последовательностей изображений в анимации для проекта "Ёлка" (см. Yolka/anim.h).
+#
+# Каждая строка каждого входного изображения - один кадр, каждый пиксель строки - один светодиод.
+# Т.е. можно подать как одну картинку, где кадры идут сверху вниз, так и набор картинок высотой в 1 пиксель.
+# Поддерживаются PNG (8 бит на канал, без чересстрочности) и PPM (P6).
+#
+# Пример:
+#   python animconv.py -n anim_twinkle --fps 25 twinkle.png >> ../Yolka/anim_data.h
+#
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAX_SKIP = 64
+MAX_RUN = 64
+MAX_LITERAL = 128
+
+OP_SKIP = 0x00
+OP_RUN = 0x40
+OP_LITERAL = 0x80
+
+FRAME_FLAG_KEY = 0x01
+
+
+def read_ppm(data):
+    tokens = []
+    pos = 2
+    while len(tokens) < 3:
+        while data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b'#':
+            while data[pos:pos + 1] not in (b'\n', b''):
+                pos += 1
+            continue
+        start = pos
+        while not data[pos:pos + 1].isspace():
+            pos += 1
+        tokens.append(int(data[start:pos]))
+    width, height, maxval = tokens
+    if maxval != 255:
+        raise ValueError('only 8-bit PPM is supported')
+    pos += 1
+    rows = []
+    for y in range(height):
+        row = []
+        for x in range(width):
+            o = pos + (y * width + x) * 3
+            row.append(tuple(data[o:o + 3]))
+        rows.append(row)
+    return rows
+
+
+def read_png(data):
+    pos = 8
+    chunks = {}
+    idat = b''
+    while pos < len(data):
+        length, ctype = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if ctype == b'IDAT':
+            idat += body
+        else:
+            chunks[ctype] = body
+    width, height, depth, ctype, _, _, interlace = struct.unpack('>IIBBBBB', chunks[b'IHDR'])
+    if depth != 8 or interlace:
+        raise ValueError('only 8-bit non-interlaced PNG is supported')
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[ctype]
+    raw = zlib.decompress(idat)
+    stride = width * channels
+    prev = bytearray(stride)
+    rows = []
+    o = 0
+    for y in range(height):
+        ft = raw[o]
+        line = bytearray(raw[o + 1:o + 1 + stride])
+        o += 1 + stride
+        for i in range(stride):
+            a = line[i - channels] if i >= channels else 0
+            b = prev[i]
+            c = prev[i - channels] if i >= channels else 0
+            if ft == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif ft == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif ft == 3:
+                line[i] = (line[i] + ((a + b) >> 1)) & 0xFF
+            elif ft == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pr = a if (pa <= pb and pa <= pc) else (b if pb <= pc else c)
+                line[i] = (line[i] + pr) & 0xFF
+        prev = line
+        row = []
+        for x in range(width):
+            px = line[x * channels:(x + 1) * channels]
+            if ctype == 3:
+                plte = chunks[b'PLTE']
+                row.append(tuple(plte[px[0] * 3:px[0] * 3 + 3]))
+            elif channels <= 2:
+                row.append((px[0], px[0], px[0]))
+            else:
+                row.append(tuple(px[:3]))
+        rows.append(row)
+    return rows
+
+
+def read_image(name):
+    with open(name, 'rb') as f:
+        data = f.read()
+    if data[:8] == b'\x89PNG\r\n\x1a\n':
+        return read_png(data)
+    if data[:2] == b'P6':
+        return read_ppm(data)
+    raise ValueError('%s: unsupported image format' % name)
+
+
+def build_palette(frames):
+    # Палитра не более 256 цветов. Если цветов больше - огрубляем младшие биты, пока не уложимся
+    for drop in range(0, 8):
+        mask = (0xFF << drop) & 0xFF
+        buckets = {}
+        for frame in frames:
+            for c in frame:
+                key = (c[0] & mask, c[1] & mask, c[2] & mask)
+                buckets.setdefault(key, []).append(c)
+        if len(buckets) <= 256:
+            break
+    palette = []
+    index = {}
+    for key, colors in sorted(buckets.items()):
+        n = len(colors)
+        avg = tuple((sum(c[i] for c in colors) + n // 2) // n for i in range(3))
+        index[key] = len(palette)
+        palette.append(avg)
+    indexed = [[index[(c[0] & mask, c[1] & mask, c[2] & mask)] for c in frame] for frame in frames]
+    return palette, indexed
+
+
+def encode_frame(cur, prev, key):
+    out = [FRAME_FLAG_KEY if key else 0]
+    n = len(cur)
+    i = 0
+    literal = []
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:MAX_LITERAL]
+            del literal[:MAX_LITERAL]
+            out.append(OP_LITERAL | (len(chunk) - 1))
+            out.extend(chunk)
+
+    while i < n:
+        if not key and cur[i] == prev[i]:
+            j = i
+            while j < n and (j - i) < MAX_SKIP and cur[j] == prev[j]:
+                j += 1
+            flush_literal()
+            out.append(OP_SKIP | (j - i - 1))
+            i = j
+            continue
+        j = i
+        while j < n and (j - i) < MAX_RUN and cur[j] == cur[i]:
+            j += 1
+        if j - i >= 3:
+            flush_literal()
+            out.append(OP_RUN | (j - i - 1))
+            out.append(cur[i])
+            i = j
+        else:
+            literal.append(cur[i])
+            i += 1
+    flush_literal()
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Converts image sequences into Yolka flash animations')
+    ap.add_argument('-n', '--name', required=True, help='C identifier of the generated array')
+    ap.add_argument('--fps', type=float, default=50.0, help='frame rate, 50 / N (default 50)')
+    ap.add_argument('--keyframe', type=int, default=0, help='insert a keyframe every N frames (0 - only the first one)')
+    ap.add_argument('images', nargs='+')
+    args = ap.parse_args()
+
+    frames = []
+    for name in args.images:
+        frames.extend(read_image(name))
+    if not frames:
+        sys.exit('no frames')
+    width = len(frames[0])
+    if any(len(f) != width for f in frames):
+        sys.exit('all frames must have the same width')
+    if width > 0xFFFF or len(frames) > 0xFFFF:
+        sys.exit('too many leds or frames')
+
+    ticks = max(1, min(255, int(round(50.0 / args.fps))))
+    palette, indexed = build_palette(frames)
+
+    data = [width & 0xFF, width >> 8, len(frames) & 0xFF, len(frames) >> 8, ticks, len(palette) & 0xFF]
+    for c in palette:
+        data.extend(c)
+    prev = None
+    for num, cur in enumerate(indexed):
+        key = (prev is None) or (args.keyframe and (num % args.keyframe) == 0)
+        data.extend(encode_frame(cur, prev, key))
+        prev = cur
+
+    raw = width * len(frames) * 3
+    print('// %s: %d LEDs, %d frames, %d ticks per frame, %d colors. %d bytes (raw RGB %d bytes)'
+          % (args.name, width, len(frames), ticks, len(palette), len(data), raw))
+    print('const PROGMEM uint8_t %s[] = {' % args.name)
+    for i in range(0, len(data), 16):
+        print('  ' + ', '.join('0x%02X' % b for b in data[i:i + 16]) + ',')
+    print('};')
+    print()
+
+
+if __name__ == '__main__':
+    main()
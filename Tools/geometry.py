@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# geometry.py
+#
+# Построение таблицы координат светодиодов для проекта "Ёлка" (см. Yolka/geometry.h).
+#
+# Исходные данные - либо измеренные координаты светодиодов (CSV: x, y, z в любых единицах, по строке на светодиод,
+# z направлена вверх), либо модель конуса, по которому гирлянда навита спиралью (--cone).
+# Результат - таблица для флеш-памяти (geometry_data.h, используется при определённом GEOMETRY_TABLE),
+# либо, с ключом --anchors N, пакет команды 'G','W' с опорными точками через каждые N светодиодов.
+#
+# Примеры:
+#   python geometry.py --cone 50 --turns 6 > ../Yolka/geometry_data.h
+#   python geometry.py --anchors 8 measured.csv
+#
+
+import argparse
+import csv
+import math
+import sys
+
+MAX_ANCHORS = 10
+
+
+def cone(leds, turns):
+    points = []
+    for i in range(leds):
+        u = i / max(1, leds - 1)
+        ang = 2 * math.pi * turns * u
+        rad = 1.0 - u
+        points.append((rad * math.cos(ang), rad * math.sin(ang), u))
+    return points
+
+
+def read_csv(name):
+    points = []
+    with open(name, newline='') as f:
+        for row in csv.reader(f):
+            if not row or row[0].strip().startswith('#'):
+                continue
+            points.append(tuple(float(v) for v in row[:3]))
+    return points
+
+
+def to_tree(points, axis=None):
+    # Ствол - вертикаль через axis, либо через центр описанного прямоугольника.
+    # Угол считается с учётом полных оборотов, чтобы опорные точки были однозначны
+    if axis:
+        cx, cy = axis
+    else:
+        cx = (min(p[0] for p in points) + max(p[0] for p in points)) / 2
+        cy = (min(p[1] for p in points) + max(p[1] for p in points)) / 2
+    zmin = min(p[2] for p in points)
+    zmax = max(p[2] for p in points)
+    rmax = max(math.hypot(p[0] - cx, p[1] - cy) for p in points) or 1.0
+    res = []
+    prev = None
+    for x, y, z in points:
+        a = math.atan2(y - cy, x - cx) / (2 * math.pi) * 256
+        if prev is not None:
+            while a - prev > 128:
+                a -= 256
+            while a - prev < -128:
+                a += 256
+        prev = a
+        h = 0 if zmax == zmin else (z - zmin) / (zmax - zmin) * 255
+        r = math.hypot(x - cx, y - cy) / rmax * 255
+        res.append((int(round(h)), int(round(a)), int(round(r))))
+    return res
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Builds Yolka LED geometry tables')
+    ap.add_argument('--cone', type=int, metavar='LEDS', help='spiral on a cone instead of measured coordinates')
+    ap.add_argument('--turns', type=float, default=6.0, help='number of turns for --cone (default 6)')
+    ap.add_argument('--anchors', type=int, metavar='N', help="print a 'G','W' packet with an anchor every N LEDs")
+    ap.add_argument('csv', nargs='?', help='measured coordinates: x, y, z per line')
+    args = ap.parse_args()
+
+    if args.cone:
+        points = cone(args.cone, args.turns)
+        axis = (0.0, 0.0)
+    elif args.csv:
+        points = read_csv(args.csv)
+        axis = None
+    else:
+        sys.exit('either --cone or a CSV file is required')
+    if len(points) < 2:
+        sys.exit('at least two LEDs are required')
+    tree = to_tree(points, axis)
+
+    if args.anchors:
+        idx = list(range(0, len(tree), args.anchors))
+        if idx[-1] != len(tree) - 1:
+            idx.append(len(tree) - 1)
+        if len(idx) > MAX_ANCHORS:
+            sys.exit('too many anchors (%d), max %d: increase N' % (len(idx), MAX_ANCHORS))
+        base = tree[0][1]
+        data = [ord('G'), ord('W'), len(idx)]
+        for i in idx:
+            h, a, r = tree[i]
+            a = (a - base) & 0xFFFF
+            data.extend([i & 0xFF, i >> 8, h, r, a & 0xFF, a >> 8])
+        print(' '.join('%02X' % b for b in data))
+        return
+
+    print('// %d LEDs: h, a, r' % len(tree))
+    print('#define GEOMETRY_TABLE_LEDS %d' % len(tree))
+    print('const PROGMEM uint8_t geometry_table[GEOMETRY_TABLE_LEDS * 3] = {')
+    for i in range(0, len(tree), 5):
+        print('  ' + ', '.join('%d, %d, %d' % (h, a & 0xFF, r) for h, a, r in tree[i:i + 5]) + ',')
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# ramreport.py
+#
+# Отчёт об использовании ОЗУ прошивкой проекта "Ёлка" по модулям (см. также Yolka/meminfo.h и команду 'Q','M').
+#
+# Разбирает map-файл компоновщика (Atmel Studio создаёт его рядом с .elf, ключ -Wl,-Map) и суммирует
+# секции .data, .bss и .noinit по объектным файлам. Остаток ОЗУ до RAMEND - то, что доступно стеку.
+#
+# Пример:
+#   python ramreport.py ../Yolka/Release/Yolka.map
+#
+
+import argparse
+import collections
+import os
+import re
+import sys
+
+RAM_SIZE = 2048  # ATmega328P
+DATA_SECTIONS = ('.data', '.bss', '.noinit', 'COMMON')
+
+# " .bss.zones    0x00800100       0x58 zones.o" или то же, но с именем секции на отдельной строке
+SECTION_RE = re.compile(r'^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+)\s*$')
+NAME_ONLY_RE = re.compile(r'^ (\S+)\s*$')
+CONT_RE = re.compile(r'^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+)\s*$')
+
+
+def is_data(name):
+    return any(name == s or name.startswith(s + '.') for s in DATA_SECTIONS)
+
+
+def module_name(path):
+    name = os.path.basename(path)
+    m = re.match(r'.*\((.*)\)$', name)  # Объект из библиотеки: libc.a(malloc.o)
+    if m:
+        name = m.group(1)
+    return name
+
+
+def parse_map(lines):
+    sizes = collections.OrderedDict()
+    pending = None
+    started = False
+    for line in lines:
+        if line.startswith('Linker script and memory map'):
+            started = True
+            continue
+        if not started:
+            continue
+        m = SECTION_RE.match(line)
+        if m:
+            pending = None
+            name, addr, size, obj = m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4)
+        else:
+            m = NAME_ONLY_RE.match(line)
+            if m:
+                pending = m.group(1)
+                continue
+            m = CONT_RE.match(line)
+            if not (m and pending):
+                pending = None
+                continue
+            name, addr, size, obj = pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+            pending = None
+        # Адреса ОЗУ в map-файле AVR смещены на 0x800000
+        if not is_data(name) or not size or addr < 0x800000 or addr >= 0x810000:
+            continue
+        mod = module_name(obj)
+        sizes[mod] = sizes.get(mod, 0) + size
+    return sizes
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Reports static RAM usage of the Yolka firmware by module')
+    ap.add_argument('mapfile')
+    ap.add_argument('--ram', type=int, default=RAM_SIZE, help='RAM size in bytes (default %d)' % RAM_SIZE)
+    args = ap.parse_args()
+
+    with open(args.mapfile, encoding='utf-8', errors='replace') as f:
+        sizes = parse_map(f)
+    if not sizes:
+        sys.exit('no RAM sections found, is it a GNU ld map file?')
+    total = sum(sizes.values())
+    for mod, size in sorted(sizes.items(), key=lambda kv: -kv[1]):
+        print('%-20s %5d' % (mod, size))
+    print('%-20s %5d' % ('total', total))
+    print('%-20s %5d' % ('left for stack', args.ram - total))
+
+
+if __name__ == '__main__':
+    main()
@@ -11,6 +11,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include <string.h>
 
 #include "ws2812.h"
 #include "wifiman.h"
@@ -18,6 +19,15 @@
 #include "Yolka.h"
 #include "effects.h"
 #include "build_version.h"
+#include "vm.h"
+#include "bench.h"
+#include "zones.h"
+#include "geometry.h"
+#include "fastrnd.h"
+#include "palette.h"
+#include "stream.h"
+#include "trace.h"
+#include "meminfo.h"
 
 #define QUOTE_X(t)#t
 #define QUOTE(t) QUOTE_X(t)
@@ -99,18 +109,26 @@ PROGMEM const ParamDesc params_list[] = {
   {EE_AP_MASK, str_ap_mask, PARAM_TYPE_STR_32, .default_pp = str_default_ap_mask}, // 10
   {EE_AP_CHAN, str_ap_chan, PARAM_TYPE_U8, .default_ui = DEFAULT_AP_CHAN, .min_ui = 1, .max_ui = 13}, // 11
     
+#ifdef FIXED_LED_COUNT
+  {EE_LED_NUM, str_led_num, PARAM_TYPE_U16, .default_ui = FIXED_LED_COUNT, .min_ui = FIXED_LED_COUNT, .max_ui = FIXED_LED_COUNT}, // 12
+#else
   {EE_LED_NUM, str_led_num, PARAM_TYPE_U16, .default_ui = DEFAULT_LED_COUNT, .min_ui = 1, .max_ui = MAX_LED_COUNT}, // 12
+#endif
   {EE_EFFECT_TIME, str_effect_time, PARAM_TYPE_U8, .default_ui = DEFAULT_EFFECT_TIME, .min_ui = 1, .max_ui = 254}, // 13
   {EE_EFFECT_TIME_ADD, str_effect_time_add, PARAM_TYPE_U8, .default_ui = DEFAULT_EFFECT_TIME_ADD, .min_ui = 0, .max_ui = 254}, // 14
   {EE_VOLTAGE_ADJUST, str_voltage_adjust, PARAM_TYPE_U16, .default_ui = DEFAULT_VOLTAGE_ADJUST, .min_ui = 1, .max_ui = 65534}, // 15
   {EE_TEMP_ADJUST, str_temp_adjust, PARAM_TYPE_U8, .default_ui = DEFAULT_TEMP_ADJUST, .min_ui = 0, .max_ui = 254}, // 16
 };  
 
+#define PARAMS_COUNT (sizeof(params_list) / sizeof(params_list[0]))
+
 led_rec brightness = {128, 128, 128}; // Текущие настройки яркости, так как они используются при выводе на ленту
 led_rec mood_brightness = {128, 128, 128}; // Заданные настройки яркости (могут быть домножены при эффектах плавного разгарания/угасания)
 uint8_t need_reoutput; // Настройки яркости сменились и, если находится в состоянии паузы, необходимо повторно выгрузить значения
 
+#ifndef FIXED_LED_COUNT
 uint16_t led_num;
+#endif
 uint8_t external_control; // Обратный счётчик, выставляется когда гирлянда управляется по сети. При достижении нуля (через 5 сек) происходит возврат к эффектам.
 uint8_t next_effect; // Номер эффекта, который будет показываться следующим
 uint16_t effect_countdown; // Обратный счётчик времени до переключения эффекта
@@ -122,13 +140,13 @@ uint8_t par_effect_time;
 uint8_t par_effect_time_add;
 uint16_t adc_acc;
 uint8_t adc_stage;
-volatile uint16_t adc_voltage;
-volatile uint16_t adc_temp;
+uint16_t adc_voltage; // Сумма 64 замеров напряжения
+uint16_t adc_temp; // Сумма 64 замеров температуры
 uint16_t adj_voltage;
 uint8_t adj_temp;
-uint8_t sendbuf[68];
 uint8_t immed_captured;
 uint8_t immed_countdown;
+uint8_t stream_frame_id; // Номер последнего выведенного кадра, переданного по частям
 
 uint8_t brightness_scaler;
 uint8_t animation_mode = ANIMATION_POWER_ON;
@@ -139,21 +157,52 @@ uint8_t power_down;
 uint16_t sleep_timer;
 uint16_t wake_timer;
 
-ISR(ADC_vect) {
+FrameStats frame_stats;
+
+// Регулятор кадров
+uint8_t frame_divider = 1; // Эффекты отрисовываются раз в столько тактов таймера
+static uint16_t frame_start; // Время такта, с которого начался текущий кадр эффекта
+static uint8_t gov_frames; // Кадров в текущем окне оценки
+static uint8_t gov_over; // Из них не уложившихся в отведённое время
+static uint8_t gov_fit; // Из них уложившихся бы и в кадр меньшей длины
+static uint8_t gov_calm; // Окон подряд, в которых все кадры уложились бы в кадр меньшей длины
+
+// Замер задержки вывода ('R','F')
+uint8_t probe_state;
+uint8_t probe_link;
+uint16_t probe_token;
+uint16_t probe_time; // Время получения команды, после вывода - задержка от неё до конца вывода кадра
+uint16_t probe_commit_time; // Время завершения кадра, после вывода - задержка от него до конца вывода
+uint8_t current_effect; // Эффект, показываемый сейчас
+uint8_t effect_restart; // Не ноль - после возврата 0 из wait_frame запустить заново current_effect, а не следующий эффект
+uint8_t notify_links; // Биты клиентов, подписанных на уведомления ('N','S')
+uint8_t notify_pending; // Биты клиентов, которым ещё не отправлено последнее изменение
+uint8_t notify_wait; // Кадров до следующей рассылки
+// Состояние на момент последнего обнаруженного изменения
+uint8_t notify_sta;
+uint8_t notify_divider;
+uint8_t notify_effect;
+uint8_t notify_animation;
+uint16_t notify_volt;
+uint8_t notify_temp;
+
+/* Вызывается по такту таймера: забирает результат преобразования АЦП, запущенного в прошлом кадре, и запускает следующее.
+ * Преобразование (около 110 мкс) идёт без прерываний, пока выполняется кадр. 
+ * 64 замера напряжения сменяются 64 замерами температуры, т.е. каждое значение обновляется раз в 128 кадров */
+static void adc_sample() {
+  if (ADCSRA & (1 << ADSC)) return; // Преобразование ещё не завершилось
   adc_acc += ADC;
   adc_stage++;
   if ((adc_stage & 63) == 0) {
     if (adc_stage == 64) {
       adc_voltage = adc_acc;
-      adc_acc = 0;
       ADMUX = ADMUX_TEMP;
     } else {
       adc_temp = adc_acc;
-      adc_acc = 0;
       ADMUX = ADMUX_VOLTAGE;
       adc_stage = 0;
-      return;
     }
+    adc_acc = 0;
   }
   ADCSRA |= (1 << ADSC);
 }
@@ -173,6 +222,13 @@ uint8_t checkpacketpgm(PGM_VOID_P p_pgm) {
   return 1;
 }
 
+/* Буфер ответа. Во время обработки пакета команд ('B') ответы складываются в него друг за другом,
+ * а sendbuf указывает на место для ответа очередной команды, под которым всегда остаётся не менее REPLY_MAX байт */
+static uint8_t reply_mem[REPLY_MAX + BATCH_EXTRA];
+uint8_t * sendbuf = reply_mem;
+static uint8_t batch_len; // Занятое ответами место в reply_mem, или 0, если пакет команд не обрабатывается
+static uint8_t batch_ready; // Ответ на пакет команд будет отправлен
+
 static uint8_t pgmz_to_buf(PGM_VOID_P pgm_z, uint8_t frompos) {
   uint8_t b;
   while ((b = pgm_read_byte(pgm_z++))) {
@@ -195,23 +251,1213 @@ static void recalculate_brightness() {
   need_reoutput = 1;
 }
 
+/* Выводит данные на ленту, приостановив приём, и учитывает время вывода */
+static void strip_output(void * led_data) {
+  uint8_t sup = wifiman_suspend_cts();
+  TRACE(TRACE_OUT, 0);
+  uint16_t t = wifiman_time();
+  led_data_out(led_data, led_num);
+  t = wifiman_time() - t;
+  TRACE(TRACE_OUT_END, 0);
+  wifiman_restore_cts(sup);
+  if (t > frame_stats.out_max) frame_stats.out_max = t;
+  need_reoutput = 0;
+}
+
 void switch_to_power_down() {
   power_down = 1;
+  zones_invalidate();
   uint8_t * p = (uint8_t*)&mem.leds[0];
   for (uint16_t cnt = led_num * 3; cnt; cnt--) {
     *(p++) = 0;
   }
-  uint8_t sup = wifiman_suspend_cts();
-  led_data_out(&mem.leds, led_num);
-  wifiman_restore_cts(sup);
-  need_reoutput = 0;
+  strip_output(&mem.leds);
+}
+
+/* Может ли клиент linkid выводить данные на ленту с приоритетом prio ('H' или 'L'): вывод не идёт, 
+ * либо идёт от этого же клиента, либо этот клиент запросил высокий приоритет, а вывод идёт с низким */
+static uint8_t immed_allowed(uint8_t linkid, uint8_t prio) {
+  return !power_down && (!immed_countdown || ((immed_captured & 0x7F) == linkid) || ((prio == 'H') && !(immed_captured & 0x80)));
+}
+
+/* Передаёт управление лентой клиенту linkid. Эффекты останавливаются, принимаемые кадры пишутся в stream_back */
+static void immed_capture(uint8_t linkid, uint8_t prio) {
+  immed_captured = ((prio == 'H') ? 0x80 : 00) | linkid;
+  immed_countdown = IMMED_COUNTDONW_INIT;
+  external_control = 255;
+  zones_invalidate();
+  stream_begin();
+}
+
+/* Выводит на ленту кадр, принятый по сети */
+static void immed_output() {
+  strip_output(&mem.leds);
+}
+
+/* Отмечает завершение кадра, если он помечен командой 'R','F' */
+static void probe_commit() {
+  if (probe_state == PROBE_TAGGED) {
+    probe_state = PROBE_COMMITTED;
+    probe_commit_time = wifiman_time();
+  }
+}
+
+/* Вызывается сразу после вывода кадра из потока на ленту: замеряет задержку для помеченного кадра */
+static void probe_output() {
+  if (probe_state == PROBE_COMMITTED) {
+    uint16_t now = wifiman_time();
+    probe_time = now - probe_time;
+    probe_commit_time = now - probe_commit_time;
+    probe_state = PROBE_DONE;
+  }
+}
+
+/* Отправляет ответ 'r','f', как только отправка станет возможна */
+static void probe_reply() {
+  if ((probe_state != PROBE_DONE) || !wifiman_ready()) return;
+  sendbuf[0] = 'r';
+  sendbuf[1] = 'f';
+  sendbuf[2] = probe_token;
+  sendbuf[3] = probe_token >> 8;
+  sendbuf[4] = probe_time;
+  sendbuf[5] = probe_time >> 8;
+  sendbuf[6] = probe_commit_time;
+  sendbuf[7] = probe_commit_time >> 8;
+  wifiman_send_buf(probe_link, sendbuf, 8);
+  probe_state = PROBE_IDLE;
+}
+
+/* Готовность к отправке ответа. В пакете команд каждая команда может ответить один раз */
+static uint8_t reply_ready() {
+  if (batch_len) return batch_ready && !sendbuf[-1];
+  return wifiman_ready();
+}
+
+/* Отправляет ответ из sendbuf, либо, в пакете команд, оставляет его в буфере */
+static void reply_buf(uint8_t linkid, void * buf, uint8_t len) {
+  if (batch_len) {
+    if (reply_ready()) sendbuf[-1] = len;
+    return;
+  }
+  wifiman_send_buf(linkid, buf, len);
+}
+
+/* Отправляет ответ - строку из флеш-памяти */
+static void reply_pgmz(uint8_t linkid, PGM_VOID_P p_pgm) {
+  if (batch_len) {
+    if (reply_ready()) sendbuf[-1] = pgmz_to_buf(p_pgm, 0);
+    return;
+  }
+  wifiman_send_pgmz(linkid, p_pgm);
+}
+
+/* Место в буфере ответа, начиная с sendbuf */
+static uint8_t reply_space() {
+  return reply_mem + sizeof(reply_mem) - sendbuf;
+}
+
+/* Записывает описание параметра pn (тип, длина имени, имя, [мин., макс.]) в sendbuf начиная с pos. Возвращает позицию за ним */
+static uint8_t param_desc_to_buf(uint8_t pn, uint8_t pos) {
+  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
+  sendbuf[pos] = pt;
+  PGM_VOID_P param_name = pgm_read_ptr(&params_list[pn].name);
+  uint8_t l = pgmz_to_buf(param_name, pos + 2);
+  sendbuf[pos + 1] = l - pos - 2;
+  if ((pt & 0xF0) == 0) {
+    uint16_t min = pgm_read_word(&params_list[pn].min_ui);
+    uint16_t max = pgm_read_word(&params_list[pn].max_ui);
+    if (max) {
+      if (pt == 0) {
+        sendbuf[l++] = min;
+        sendbuf[l++] = max;
+      } else {
+        sendbuf[l++] = min;
+        sendbuf[l++] = min >> 8;
+        sendbuf[l++] = max;
+        sendbuf[l++] = max >> 8;
+      }
+    }
+  }
+  return l;
+}
+
+/* Записывает значение параметра pn (длина, значение) в sendbuf начиная с pos. Возвращает позицию за ним */
+static uint8_t param_value_to_buf(uint8_t pn, uint8_t pos) {
+  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
+  uint16_t ee = pgm_read_word(&params_list[pn].ee_off);
+  uint8_t * v = &sendbuf[pos + 1];
+  uint8_t l;
+  if (pt & 0xF0) {
+    uint8_t b = eeprom_read(ee++, 0xFF);
+    l = 0;
+    if (b != 0xFF) {
+      uint8_t mx = (pt == PARAM_TYPE_STR_64) ? 64 : 32;
+      while (b) {
+        v[l] = b;
+        l++;
+        if (l >= mx) break;
+        b = eeprom_read(ee++, 0xFF);
+      }
+    } else { // Если параметр не задан, то пытаемся начитать и вернуть значение по-умолчанию
+      PGM_VOID_P pdef = pgm_read_ptr(&params_list[pn].default_pp);
+      if (pdef) {
+        l = pgmz_to_buf(pdef, pos + 1) - pos - 1;
+      }
+    }                    
+  } else {
+    l = 1;
+    v[0] = eeprom_read(ee++, 0xFF);
+    if (pt == PARAM_TYPE_U16) {
+      l = 2;
+      v[1] = eeprom_read(ee++, 0xFF);
+      if ((v[0] & v[1]) == 0xFF) {
+        uint16_t def = pgm_read_word(&params_list[pn].default_ui);
+        v[0] = def;
+        v[1] = def >> 8;
+      }
+    } else {
+      if (v[0] == 0xFF) {
+        v[0] = pgm_read_byte(&params_list[pn].default_ui);
+      }
+    }
+  }
+  sendbuf[pos] = l;
+  return pos + 1 + l;
+}
+
+/* Наибольшая длина значения параметра pn */
+static uint8_t param_max_len(uint8_t pn) {
+  return 1 << (pgm_read_byte(&params_list[pn].par_type) & 0x0F);
+}
+
+/* Наибольший размер записи param_desc_to_buf (desc != 0) или param_value_to_buf для параметра pn */
+static uint8_t param_rec_max(uint8_t pn, uint8_t desc) {
+  if (desc) return 6 + strlen_P(pgm_read_ptr(&params_list[pn].name));
+  return 1 + param_max_len(pn);
+}
+
+/* Проверяет значение v длиной l (не более param_max_len) для параметра pn. Возвращает 1, если значение допустимо */
+static uint8_t param_check(uint8_t pn, uint8_t l, const uint8_t * v) {
+  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
+  if (!l) return 1; // Сброс к значению по-умолчанию
+  if (pt >= 0x80) {
+    if (v[0] == 0xFF) return 0;
+    for (uint8_t i = 0; i < l; i++) {
+      if (v[i] == 0x00) return 0;
+    }
+    return 1;
+  }
+  if (l != param_max_len(pn)) return 0;
+  uint16_t x = (pt == PARAM_TYPE_U8) ? v[0] : (v[0] | (v[1] << 8));
+  uint16_t min = pgm_read_word(&params_list[pn].min_ui);
+  uint16_t max = pgm_read_word(&params_list[pn].max_ui);
+  if (!max) max = (pt == PARAM_TYPE_U8) ? 254 : 65534;
+  return (x >= min) && (x <= max);
+}
+
+/* Записывает проверенное значение параметра в EEPROM и применяет его */
+static void param_store(uint8_t pn, uint8_t l, const uint8_t * v) {
+  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
+  uint16_t ee = pgm_read_word(&params_list[pn].ee_off);
+  uint8_t maxl = param_max_len(pn);
+  for (uint8_t i = 0; i < l; i++) {
+    eeprom_write(ee++, v[i]);
+  }
+  if (l < maxl) {
+    uint8_t pl = l;
+    if ((pt >= 0x80) && l) {
+      eeprom_write(ee++, 0x00);
+      pl++;
+    }                        
+    while (pl < maxl) {
+      eeprom_write(ee++, 0xFF);
+      pl++;
+    }
+  }                      
+  switch (pn) {
+#ifndef FIXED_LED_COUNT
+    case PARAM_LED_NUM: 
+      led_num = (l && (v[0] | v[1]) && ((v[0] | (v[1] << 8)) <= MAX_LED_COUNT)) ? (v[0] | (v[1] << 8)) : DEFAULT_LED_COUNT; 
+      zones_invalidate(); // Зоны обрезаются по длине ленты, перед следующим кадром они будут построены заново
+      stream_release(); // Палитра могла оказаться на месте светодиодов
+      break;
+#endif
+    case PARAM_EFFECT_TIME: 
+      par_effect_time = (l && v[0] && (v[0] < 255)) ? v[0] : DEFAULT_EFFECT_TIME; 
+      break;
+    case PARAM_EFFECT_TIME_ADD: 
+      par_effect_time_add = (l && (v[0] < 255)) ? v[0] : DEFAULT_EFFECT_TIME_ADD; 
+      break;
+    case PARAM_VOLTAGE_ADJUST: 
+      adj_voltage = (l && ((v[0] & v[1]) < 255)) ? (v[0] | (v[1] << 8)) : DEFAULT_VOLTAGE_ADJUST; 
+      break;
+    case PARAM_TEMP_ADJUST: 
+      adj_temp = (l && (v[0] < 255)) ? v[0] : DEFAULT_TEMP_ADJUST; 
+      break;
+  }
+}
+
+#define STATUS_SIZE 8 // Размер состояния, записываемого status_to_buf
+
+/* Записывает в buf[0..STATUS_SIZE - 1] состояние гирлянды для клиента linkid (ответ 'q','p'). 
+ * Последний байт - делитель частоты кадров эффектов (см. frame_divider) */
+static void status_to_buf(uint8_t * buf, uint8_t linkid) {
+  uint16_t volt = adc_voltage;
+  uint16_t temp = adc_temp;
+  uint8_t sta = 0;
+  if (!power_down && (animation_mode != ANIMATION_POWER_OFF) && (animation_mode != ANIMATION_SLEEP)) sta |= 0x01; // Включено 
+  if (sleep_timer) sta |= 0x02; // Таймер спячки
+  if (wake_timer) sta |= 0x04; // Таймер пробуждения
+  if (external_control) sta |= 0x08; // Лента управляется снаружи
+  if (power_down | (immed_countdown && ((immed_captured & 0x7F) != linkid))) sta |= 0x10; // Вывод данных в низком приоритете будет проигнорирован
+  if (frame_divider > 1) sta |= 0x20; // Регулятор кадров понизил частоту отрисовки эффектов
+  buf[0] = sta;
+  buf[1] = (uint8_t)led_num;
+  buf[2] = led_num >> 8;
+  buf[3] = num_effects;
+  uint16_t rvolt = ((uint32_t)volt * adj_voltage + 32768) >> 16;
+  buf[4] = rvolt;
+  buf[5] = rvolt >> 8;
+  // 340 примерно соответствует 25 градусам??
+  buf[6] = (temp >> 6) - 443  + adj_temp;
+  buf[7] = frame_divider;
+}
+
+/* Вызывается каждый кадр. Сравнивает состояние с последним разосланным и, если оно изменилось, рассылает подписчикам
+ * уведомление 'n','p': те же данные, что в ответе 'q','p', затем текущий эффект и animation_mode.
+ * Изменения за время ожидания объединяются: уведомление несёт состояние на момент отправки. За кадр отправляется
+ * не более одного уведомления, одному клиенту - не чаще раза в NOTIFY_INTERVAL кадров */
+static void notify_frame() {
+  if (!notify_links) return;
+  uint8_t st[STATUS_SIZE];
+  status_to_buf(st, 0xFF); // Пока идёт отправка, sendbuf трогать нельзя
+  uint16_t volt = st[4] | (st[5] << 8);
+  int8_t dt = st[6] - notify_temp;
+  if ((st[0] != notify_sta) || (st[7] != notify_divider) || (current_effect != notify_effect) || (animation_mode != notify_animation)
+      || (volt > (notify_volt + NOTIFY_VOLT_STEP)) || ((volt + NOTIFY_VOLT_STEP) < notify_volt)
+      || (dt >= NOTIFY_TEMP_STEP) || (dt <= -NOTIFY_TEMP_STEP)) {
+    notify_sta = st[0];
+    notify_divider = st[7];
+    notify_effect = current_effect;
+    notify_animation = animation_mode;
+    notify_volt = volt;
+    notify_temp = st[6];
+    notify_pending = notify_links;
+  }
+  if (notify_wait) {
+    notify_wait--;
+    return;
+  }
+  if (!notify_pending || !wifiman_ready()) return;
+  uint8_t linkid = 0;
+  while (!(notify_pending & (1 << linkid))) linkid++;
+  notify_pending &= ~(1 << linkid);
+  if (!notify_pending) notify_wait = NOTIFY_INTERVAL;
+  sendbuf[0] = 'n';
+  sendbuf[1] = 'p';
+  status_to_buf(&sendbuf[2], linkid);
+  sendbuf[2 + STATUS_SIZE] = current_effect;
+  sendbuf[3 + STATUS_SIZE] = animation_mode;
+  wifiman_send_buf(linkid, sendbuf, 4 + STATUS_SIZE);
+}
+
+/* Выполняет команду cmd, полученную от клиента linkid. Возвращает 0, если отрисовку эффектов нужно прервать:
+ * лента перешла под управление клиента, буфер светодиодов испорчен, или эффект нужно запустить заново (effect_restart) */
+static uint8_t process_command(uint8_t linkid, uint8_t cmd) {
+  TRACE(TRACE_PACKET, cmd);
+  switch (cmd) {
+    case 'Y': 
+      if (checkpacketpgm(PSTR("OLKA_BLST"))) {
+        if (wifiman_ready()) {
+          wifiman_send_pgmz(linkid, &str_reconnect);
+          while (!wifiman_ready()) wifiman_pull();
+          wifiman_close(linkid);
+          wifiman_wait_outbuf();
+          run_bootloader();
+        }              
+      }
+      break;
+    case 'S':
+      if (checkpacketpgm(PSTR("ETMAGIC"))) {
+        if (reply_ready()) {
+          eeprom_write(EE_MAGIC, MAGIC_PROGRAMMED);
+          reply_pgmz(linkid, &str_magicok);
+        }              
+      }
+      break;
+    case 'D': {
+      uint8_t b = wifiman_read();
+      if ((b == 'H') || (b == 'L')) {
+        if (immed_allowed(linkid, b))  {
+          immed_capture(linkid, b);
+          stream_read_raw(stream_back, led_num);
+          stream_commit();
+          probe_commit();
+          return 0;
+        }            
+      } else if (b == 'S') { // Часть кадра: приоритет, номер кадра, первый светодиод (2), количество (2), флаги, данные (в формате из флагов, см. stream.h)
+        uint8_t prio = wifiman_read();
+        uint8_t fid = wifiman_read();
+        uint16_t start = wifiman_read();
+        start |= wifiman_read() << 8;
+        uint16_t cnt = wifiman_read();
+        cnt |= wifiman_read() << 8;
+        uint8_t flags = wifiman_read();
+        if (((prio != 'H') && (prio != 'L')) || (start > led_num) || (cnt > (led_num - start)) || (wifiman_packet_len() < stream_data_size(flags, cnt))
+            || (((flags & STREAM_FORMAT_MASK) == STREAM_FORMAT_INDEX) && !stream_palette_size)) {
+          if (reply_ready()) reply_pgmz(linkid, &str_error);
+        } else if (immed_allowed(linkid, prio)) {
+          // Запоздавшие части уже выведенного кадра отбрасываются
+          if (immed_countdown && ((immed_captured & 0x7F) == linkid) && ((int8_t)(fid - stream_frame_id) <= 0)) break;
+          immed_capture(linkid, prio);
+          stream_read(flags, &stream_back[start], cnt);
+          if (flags & STREAM_FLAG_COMMIT) {
+            stream_frame_id = fid;
+            stream_commit();
+            probe_commit();
+          }
+          return 0;
+        }
+      } else if (b == 'C') { // Сжатый кадр: приоритет, флаги, команды (см. stream.h)
+        uint8_t prio = wifiman_read();
+        uint8_t flags = wifiman_read();
+        if ((prio != 'H') && (prio != 'L')) {
+          if (reply_ready()) reply_pgmz(linkid, &str_error);
+        } else if (immed_allowed(linkid, prio)) {
+          if (!(flags & STREAM_FRAME_KEY) && !(immed_countdown && ((immed_captured & 0x7F) == linkid))) {
+            // Предыдущего кадра этого клиента в буфере нет, нужен ключевой кадр
+            if (reply_ready()) reply_pgmz(linkid, &str_error);
+            break;
+          }
+          immed_capture(linkid, prio);
+          if (flags & STREAM_FRAME_KEY) clear(stream_back, led_num);
+          stream_read_rle(stream_back, led_num);
+          stream_commit();
+          probe_commit();
+          return 0;
+        }
+      } else if (b == 'K') { // Ключевой кадр: приоритет, количество тактов перехода, [led_num троек r, g, b]
+        // Без данных переход выполняется к кадру, собранному в буфере приёма частями 'D','S' без флага завершения
+        uint8_t prio = wifiman_read();
+        uint8_t frames = wifiman_read();
+        uint16_t len = wifiman_packet_len();
+        if (((prio != 'H') && (prio != 'L')) || (len && (len < led_num * 3))) {
+          if (reply_ready()) reply_pgmz(linkid, &str_error);
+        } else if (immed_allowed(linkid, prio)) {
+          immed_capture(linkid, prio);
+          if (len) stream_read_raw(stream_back, led_num);
+          stream_commit_fade(frames);
+          probe_commit();
+          return 0;
+        }
+      } else if (b == 'P') { // Палитра для кадров STREAM_FORMAT_INDEX: приоритет, количество цветов (0 - 256), тройки r, g, b
+        uint8_t prio = wifiman_read();
+        uint16_t cnt = wifiman_read();
+        if (!cnt) cnt = 256;
+        if (reply_ready()) {
+          if (((prio != 'H') && (prio != 'L')) || (wifiman_packet_len() < cnt * 3)) {
+            reply_pgmz(linkid, &str_error);
+          } else if (immed_allowed(linkid, prio)) {
+            immed_capture(linkid, prio); // Палитра занимает конец буфера, которым пользуются эффекты
+            uint8_t ok = stream_palette_load(cnt);
+            stream_begin(); // Буфер приёма перемещается ниже палитры
+            if (ok) {
+              sendbuf[0] = 'd';
+              sendbuf[1] = 'p';
+              sendbuf[2] = cnt;
+              reply_buf(linkid, sendbuf, 3);
+            } else {
+              reply_pgmz(linkid, &str_error);
+            }
+            return 0;
+          }
+        }
+      }
+    } break;
+    case 'Q':
+      switch (wifiman_read()) {
+        case 'P':
+          if (reply_ready()) {
+            sendbuf[0] = 'q';
+            sendbuf[1] = 'p';
+            status_to_buf(&sendbuf[2], linkid);
+            reply_buf(linkid, sendbuf, 2 + STATUS_SIZE);
+          }               
+          break;
+        case 'C': // Счётчики производительности: 'Q','C',[1 - сбросить после чтения]
+          if (reply_ready()) {
+            uint8_t reset = wifiman_read();
+            sendbuf[0] = 'q';
+            sendbuf[1] = 'c';
+            // Сначала FrameStats, затем WifimanStats, как они лежат в памяти (младшие байты первыми)
+            uint8_t l = 2;
+            cli();
+            for (uint8_t i = 0; i < sizeof(frame_stats); i++) sendbuf[l++] = ((uint8_t*)&frame_stats)[i];
+            for (uint8_t i = 0; i < sizeof(wifiman_stats); i++) sendbuf[l++] = ((uint8_t*)&wifiman_stats)[i];
+            if (reset) {
+              memset(&frame_stats, 0, sizeof(frame_stats));
+              memset(&wifiman_stats, 0, sizeof(wifiman_stats));
+            }
+            sei();
+            reply_buf(linkid, sendbuf, l);
+          }
+          break;
+        case 'T': // Журнал событий (см. trace.h). Ответ: 'q','t',количество,<время (2), событие, аргумент>...
+          if (reply_ready()) {
+#ifdef TRACE_BUFFER
+            sendbuf[0] = 'q';
+            sendbuf[1] = 't';
+            uint8_t n = trace_dump((TraceRec *)&sendbuf[3]);
+            sendbuf[2] = n;
+            reply_buf(linkid, sendbuf, 3 + n * sizeof(TraceRec));
+#else
+            reply_pgmz(linkid, &str_error);
+#endif
+          }
+          break;
+        case 'M': // Использование ОЗУ (см. meminfo.h). Ответ: 'q','m', затем по 2 байта: стек не затрагивался, свободно сейчас,
+          // статические переменные всего, из них: mem, буфер ответов, очереди приёма и передачи, состояние первой зоны, журнал событий;
+          // затем кадр ленты (led_num * 3) и остаток mem за ним (для таблиц и состояний зон)
+          if (reply_ready()) {
+            uint16_t v[] = {
+              meminfo_stack_unused(), 
+              meminfo_stack_free(), 
+              meminfo_static_size(),
+              sizeof(mem),
+              sizeof(reply_mem),
+              IN_QUEUE_SIZE + OUT_QUEUE_SIZE,
+              EFFECT_STATE_SIZE,
+#ifdef TRACE_BUFFER
+              TRACE_SIZE * sizeof(TraceRec),
+#else
+              0,
+#endif
+              led_num * 3,
+              sizeof(mem) - led_num * 3
+            };
+            sendbuf[0] = 'q';
+            sendbuf[1] = 'm';
+            uint8_t l = 2;
+            for (uint8_t i = 0; i < (sizeof(v) / sizeof(v[0])); i++) {
+              sendbuf[l++] = v[i];
+              sendbuf[l++] = v[i] >> 8;
+            }
+            reply_buf(linkid, sendbuf, l);
+          }
+          break;
+      }
+      break;
+    case 'R': // Замер задержек
+      switch (wifiman_read()) {
+        case 'P': // Эхо: 'R','P',<данные> -> 'r','p',<те же данные>
+          if (reply_ready()) {
+            uint8_t l = 2;
+            while (wifiman_packet_len() && (l < REPLY_MAX)) sendbuf[l++] = wifiman_read();
+            sendbuf[0] = 'r';
+            sendbuf[1] = 'p';
+            reply_buf(linkid, sendbuf, l);
+          }
+          break;
+        case 'F': // Пометить следующий кадр 'D': 'R','F',метка (2). После его вывода на ленту придёт
+          // 'r','f',метка (2),<такты от команды до конца вывода> (2),<такты от завершения кадра до конца вывода> (2)
+          probe_token = wifiman_read();
+          probe_token |= wifiman_read() << 8;
+          probe_link = linkid;
+          probe_time = wifiman_time();
+          probe_state = PROBE_TAGGED;
+          break;
+      }
+      break;
+    case 'N': // Подписка на уведомления об изменении состояния
+      switch (wifiman_read()) {
+        case 'S': notify_links |= (1 << linkid); notify_pending |= (1 << linkid); break;
+        case 'U': notify_links &= ~(1 << linkid); notify_pending &= ~(1 << linkid); break;
+        default: return 1;
+      }
+      if (reply_ready()) {
+        sendbuf[0] = 'n';
+        sendbuf[1] = (notify_links & (1 << linkid)) ? 's' : 'u';
+        reply_buf(linkid, sendbuf, 2);
+      }
+      break;
+    case 'P': 
+      switch (wifiman_read()) {
+        case 'C': // Количество параметров
+          if (reply_ready() && !ymode) {
+            sendbuf[0] = 'p';
+            sendbuf[1] = 'c';
+            sendbuf[2] = PARAMS_COUNT;
+            reply_buf(linkid, sendbuf, 3);
+          }
+          break;
+        case 'D':  // Описание параметра
+          if (reply_ready()) {
+            uint8_t pn = wifiman_packet_len() ? wifiman_read() : 255;
+            if (pn >= PARAMS_COUNT) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'p';
+              sendbuf[1] = 'd';
+              sendbuf[2] = pn;
+              reply_buf(linkid, sendbuf, param_desc_to_buf(pn, 3));
+            }
+          }
+          break;
+        case 'A': // Описания или значения нескольких параметров подряд: 'P','A',<'D' или 'R'>,первый
+          if (reply_ready()) {
+            uint8_t desc = (wifiman_read() == 'D');
+            uint8_t pn = wifiman_read();
+            if (pn >= PARAMS_COUNT) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'p';
+              sendbuf[1] = 'a';
+              sendbuf[2] = pn;
+              // Записи в формате ответов 'p','d' / 'p','r' без номера; сколько поместилось - клиент узнает, разобрав ответ
+              uint8_t l = 3;
+              uint8_t space = reply_space();
+              do {
+                l = desc ? param_desc_to_buf(pn, l) : param_value_to_buf(pn, l);
+                pn++;
+              } while ((pn < PARAMS_COUNT) && ((l + param_rec_max(pn, desc)) <= space));
+              reply_buf(linkid, sendbuf, l);
+            }
+          }
+          break;
+        case 'I':
+          if (reply_ready() && !ymode) {
+            reply_pgmz(linkid, PSTR("REINIT"));
+            ymode = YMODE_REINIT;
+          }
+          break;
+        case 'R':
+          if (reply_ready()) {
+            uint8_t pn = wifiman_packet_len() ? wifiman_read() : 255;
+            if (pn >= PARAMS_COUNT) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'p';
+              sendbuf[1] = 'r';
+              sendbuf[2] = pn;
+              reply_buf(linkid, sendbuf, param_value_to_buf(pn, 3));
+            }
+          }
+          break;
+        case 'W': // установка параметра
+          if (reply_ready()) {
+            uint8_t pn = (wifiman_packet_len() >= 2) ? wifiman_read() : 255;
+            uint8_t l = wifiman_read();
+            if ((pn >= PARAMS_COUNT) || (l > wifiman_packet_len()) || (l > param_max_len(pn))) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              for (uint8_t i = 0; i < l; i++) {
+                sendbuf[3 + i] = wifiman_read();
+              }
+              if (!param_check(pn, l, &sendbuf[3])) {
+                reply_pgmz(linkid, &str_error);
+              } else {
+                param_store(pn, l, &sendbuf[3]);
+                sendbuf[0] = 'p';
+                sendbuf[1] = 'w';
+                sendbuf[2] = pn;
+                reply_buf(linkid, sendbuf, 3);
+              }
+            }
+          }
+          break;
+        case 'M': // Запись нескольких параметров разом: 'P','M',<номер, длина, значение>...
+          // Сначала проверяются все значения, и только если все допустимы - записываются
+          if (reply_ready()) {
+            uint8_t space = reply_space();
+            uint8_t l = 2;
+            uint8_t cnt = 0;
+            uint8_t err = 0;
+            while (wifiman_packet_len() && !err) {
+              uint8_t pn = (wifiman_packet_len() >= 2) ? wifiman_read() : 255;
+              uint8_t pl = wifiman_read();
+              if ((pn >= PARAMS_COUNT) || (pl > wifiman_packet_len()) || (pl > param_max_len(pn)) || ((l + 2 + pl) > space)) {
+                err = 1;
+              } else {
+                sendbuf[l++] = pn;
+                sendbuf[l++] = pl;
+                for (uint8_t i = 0; i < pl; i++) sendbuf[l++] = wifiman_read();
+                if (!param_check(pn, pl, &sendbuf[l - pl])) err = 1;
+                cnt++;
+              }
+            }
+            if (err || !cnt) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              uint8_t * v = &sendbuf[2];
+              for (uint8_t i = cnt; i; i--) {
+                uint8_t pl = v[1];
+                param_store(v[0], pl, v + 2);
+                v += 2 + pl;
+              }
+              sendbuf[0] = 'p';
+              sendbuf[1] = 'm';
+              sendbuf[2] = cnt;
+              reply_buf(linkid, sendbuf, 3);
+            }
+          }
+          break;
+      }
+      break;
+    case 'E': 
+      switch (wifiman_read()) {
+        case 'C': // Количество эффектов
+          if (reply_ready() && !ymode) {
+            sendbuf[0] = 'e';
+            sendbuf[1] = 'c';
+            sendbuf[2] = num_effects;
+            reply_buf(linkid, sendbuf, 3);
+          }
+          break;
+        case 'D':  // Описание эффекта
+          if (reply_ready()) {
+            uint8_t efn = wifiman_packet_len() ? wifiman_read() : 255;
+            if (efn >= num_effects) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'e';
+              sendbuf[1] = 'd';
+              sendbuf[2] = efn;
+              PGM_VOID_P ef_name = pgm_read_ptr(&effects_list[efn].effect_name);
+              uint8_t l = pgmz_to_buf(ef_name, 4);
+              sendbuf[3] = l - 4;
+              reply_buf(linkid, sendbuf, l);
+            }
+          }
+          break;
+        case 'A': // Названия нескольких эффектов подряд: 'E','A',первый. Ответ: 'e','a',первый,<длина, название>...
+          if (reply_ready()) {
+            uint8_t efn = wifiman_read();
+            if (efn >= num_effects) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'e';
+              sendbuf[1] = 'a';
+              sendbuf[2] = efn;
+              uint8_t l = 3;
+              uint8_t space = reply_space();
+              do {
+                PGM_VOID_P ef_name = pgm_read_ptr(&effects_list[efn].effect_name);
+                uint8_t e = pgmz_to_buf(ef_name, l + 1);
+                sendbuf[l] = e - l - 1;
+                l = e;
+                efn++;
+              } while ((efn < num_effects) && ((l + 1 + strlen_P(pgm_read_ptr(&effects_list[efn].effect_name))) <= space));
+              reply_buf(linkid, sendbuf, l);
+            }
+          }
+          break;
+        case 'S': {
+          uint8_t efn = wifiman_packet_len() ? wifiman_read() : 255;
+          if (efn < num_effects) {
+            next_effect = efn;
+            if (external_control > 5) external_control = 5;
+            effect_countdown = 0;
+            if (reply_ready()) {
+              sendbuf[0] = 'e';
+              sendbuf[1] = 's';
+              sendbuf[2] = efn;
+              reply_buf(linkid, sendbuf, 3);
+            }
+          } else {
+            reply_pgmz(linkid, &str_error);
+          }
+        } break;
+      }
+      break;
+    case 'M': // Настройки настроения (яркости)
+      switch (wifiman_read()) {
+        case 'S': // Установка значения
+          if (wifiman_packet_len() < 3) {
+            reply_pgmz(linkid, &str_error);
+          }  else {
+            mood_brightness.r = wifiman_read();
+            mood_brightness.g = wifiman_read();
+            mood_brightness.b = wifiman_read();
+            recalculate_brightness();
+            sendbuf[0] = 'm';
+            sendbuf[1] = 's';
+            sendbuf[2] = mood_brightness.r;
+            sendbuf[3] = mood_brightness.g;
+            sendbuf[4] = mood_brightness.b;
+            reply_buf(linkid, sendbuf, 5);
+          }            
+          break;
+        case 'R': // Чтенение значений яркости
+          sendbuf[0] = 'm';
+          sendbuf[1] = 'r';
+          sendbuf[2] = mood_brightness.r;
+          sendbuf[3] = mood_brightness.g;
+          sendbuf[4] = mood_brightness.b;
+          reply_buf(linkid, sendbuf, 5);
+          break;
+      }          
+      break;
+    case 'W': 
+      if (wifiman_packet_len() >= 18) {
+        for (uint8_t i = 0; i < 18; i++) {
+          sendbuf[i] = wifiman_read();
+        }
+        uint8_t x = 5;
+        for (int i = 17; i >= 0; i--) {
+          x = (sendbuf[i] * 11) ^ x;
+          sendbuf[i] = x;
+        }
+        static const PROGMEM uint8_t xtbl[] = { 0xC4, 0x46, 0x14, 0xEF, 0x47, 0xFF, 0xC9, 0x8B, 0xDD, 0xAB, 0xFA, 0x28, 0x63, 0x3B, 0xB8, 0x29, 0xE6, 0xCF};
+        x = 83;
+        for (uint8_t i = 0; i < 18; i++) {
+          x = (pgm_read_byte(&xtbl[i]) ^ ((sendbuf[i] * 5) & 0xFF)) + x * 3;
+          sendbuf[i] = x;
+        }
+        if (!x) reply_buf(linkid, sendbuf, 17);
+      }          
+      break;
+    case 'L': // Настройки управления питанием (яркости)
+      switch (wifiman_read()) {
+        case 'R': // Чтенение состояния 
+          sendbuf[0] = 'l';
+          sendbuf[1] = 'r';
+          sendbuf[2] = ((power_down) || (animation_mode == ANIMATION_SLEEP) || (animation_mode == ANIMATION_POWER_OFF)) ? 0 : 1;
+          sendbuf[3] = wake_timer;
+          sendbuf[4] = wake_timer >> 8;
+          sendbuf[5] = sleep_timer;
+          sendbuf[6] = sleep_timer >> 8;
+          reply_buf(linkid, sendbuf, 7);
+          break;
+        case 'O': // Управление питанием
+          if (wifiman_packet_len() < 1) {
+            reply_pgmz(linkid, &str_error);
+          } else {
+            uint8_t p = wifiman_read();
+            if ((p != 0) && (p != 1)) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              if (!p) {
+                animation_mode = ANIMATION_POWER_OFF;
+                // Таймер сна не отменяется, если он настроен ЗА таймером пробуждения
+                if (!wake_timer || (sleep_timer <= wake_timer)) sleep_timer = 0;
+              } else {
+                power_down = 0;
+                animation_mode = ANIMATION_POWER_ON;
+                // Таймер пробуждения не отменяется, если он настроен ЗА таймером сна
+                if (!sleep_timer || (wake_timer <= sleep_timer)) wake_timer = 0;
+              }
+              sendbuf[0] = 'l';
+              sendbuf[1] = 'o';
+              sendbuf[2] = p;
+              reply_buf(linkid, sendbuf, 3);
+            }
+          }            
+          break;
+        case 'W': // Установка таймера пробуждения
+          if (wifiman_packet_len() < 2) {
+            reply_pgmz(linkid, &str_error);
+          } else {
+            uint16_t wt = wifiman_read() | (wifiman_read() << 8);
+            wake_timer = wt;
+            
+            if (wt) {
+              if (!power_down && (!sleep_timer || (wt < sleep_timer))) {
+                animation_mode = ANIMATION_POWER_OFF;
+              }
+            }
+            sendbuf[0] = 'l';
+            sendbuf[1] = 'w';
+            sendbuf[2] = wt;
+            sendbuf[3] = wt >> 8;
+            reply_buf(linkid, sendbuf, 4);
+          }            
+          break;
+        case 'S': // Установка таймера сна
+          if (wifiman_packet_len() < 2) {
+            reply_pgmz(linkid, &str_error);
+          } else {
+            uint16_t st = wifiman_read() | (wifiman_read() << 8);
+            sleep_timer = st;
+            
+            if (st) {
+              if (!wake_timer || (st < wake_timer)) {
+                power_down = 0;
+                animation_mode = ANIMATION_POWER_ON;
+              }
+            }
+            sendbuf[0] = 'l';
+            sendbuf[1] = 's';
+            sendbuf[2] = st;
+            sendbuf[3] = st >> 8;
+            reply_buf(linkid, sendbuf, 4);
+          }            
+          break;
+      }          
+      break;
+    case 'X': // Программы для виртуальной машины
+      switch (wifiman_read()) {
+        case 'W': // Запись программы в слот: 'X','W',slot,lf,lp,<код покадровой программы>,<код пиксельной программы>
+          if (reply_ready()) {
+            uint8_t slot = (wifiman_packet_len() >= 3) ? wifiman_read() : 255;
+            uint8_t lf = wifiman_read();
+            uint8_t lp = wifiman_read();
+            if ((slot >= VM_SLOTS) || (lf > VM_CODE_SIZE) || (lp > (VM_CODE_SIZE - lf)) || ((lf + lp) > wifiman_packet_len())) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              for (uint8_t i = 0; i < (lf + lp); i++) {
+                sendbuf[3 + i] = wifiman_read();
+              }
+              if (!vm_check(&sendbuf[3], lf, 0) || !vm_check(&sendbuf[3 + lf], lp, 1)) {
+                reply_pgmz(linkid, &str_error);
+              } else {
+                uint16_t ee = EE_VM_BASE + slot * VM_SLOT_SIZE;
+                eeprom_write(ee++, lf);
+                eeprom_write(ee++, lp);
+                for (uint8_t i = 0; i < (lf + lp); i++) {
+                  eeprom_write(ee++, sendbuf[3 + i]);
+                }
+                sendbuf[0] = 'x';
+                sendbuf[1] = 'w';
+                sendbuf[2] = slot;
+                reply_buf(linkid, sendbuf, 3);
+                zones_invalidate(); // Слот может показываться в любой из зон
+                effect_restart = 1;
+                return 0; // Текущий эффект запускается заново и загружает новую программу
+              }
+            }
+          }
+          break;
+        case 'R': // Чтение программы из слота: 'X','R',slot
+          if (reply_ready()) {
+            uint8_t slot = wifiman_packet_len() ? wifiman_read() : 255;
+            if (slot >= VM_SLOTS) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              uint16_t ee = EE_VM_BASE + slot * VM_SLOT_SIZE;
+              uint8_t lf = eeprom_read(ee++, 0xFF);
+              uint8_t lp = eeprom_read(ee++, 0);
+              if ((lf > VM_CODE_SIZE) || (lp > (VM_CODE_SIZE - lf))) lf = lp = 0;
+              sendbuf[0] = 'x';
+              sendbuf[1] = 'r';
+              sendbuf[2] = slot;
+              sendbuf[3] = lf;
+              sendbuf[4] = lp;
+              for (uint8_t i = 0; i < (lf + lp); i++) {
+                sendbuf[5 + i] = eeprom_read(ee++, 0xFF);
+              }
+              reply_buf(linkid, sendbuf, lf + lp + 5);
+            }
+          }
+          break;
+      }
+      break;
+    case 'T': // Замеры производительности
+      switch (wifiman_read()) {
+        case 'C': // Количество тестов
+          if (reply_ready()) {
+            sendbuf[0] = 't';
+            sendbuf[1] = 'c';
+            sendbuf[2] = num_benches;
+            reply_buf(linkid, sendbuf, 3);
+          }
+          break;
+        case 'D': // Описание теста
+          if (reply_ready()) {
+            uint8_t bn = wifiman_packet_len() ? wifiman_read() : 255;
+            if (bn >= num_benches) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 't';
+              sendbuf[1] = 'd';
+              sendbuf[2] = bn;
+              uint8_t l = pgmz_to_buf(pgm_read_ptr(&bench_list[bn].name), 4);
+              sendbuf[3] = l - 4;
+              reply_buf(linkid, sendbuf, l);
+            }
+          }
+          break;
+        case 'R': // Выполнение теста: 'T','R',bn,cl,ch. Ответ: 't','r',bn,cl,ch,<затраченные такты процессора, 4 байта>
+                  // Если тест выполнялся дольше секунды (BENCH_TIME_LIMIT) - ошибка, count нужно уменьшить
+          if (reply_ready()) {
+            uint8_t bn = (wifiman_packet_len() >= 3) ? wifiman_read() : 255;
+            uint16_t cnt = wifiman_read();
+            cnt |= wifiman_read() << 8;
+            if (bn >= num_benches) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              uint32_t cycles = bench_run(bn, cnt);
+              if (cycles == BENCH_OVERTIME) {
+                reply_pgmz(linkid, &str_error);
+                zones_invalidate();
+                stream_release();
+                return 0;
+              }
+              sendbuf[0] = 't';
+              sendbuf[1] = 'r';
+              sendbuf[2] = bn;
+              sendbuf[3] = cnt;
+              sendbuf[4] = cnt >> 8;
+              sendbuf[5] = cycles;
+              sendbuf[6] = cycles >> 8;
+              sendbuf[7] = cycles >> 16;
+              sendbuf[8] = cycles >> 24;
+              reply_buf(linkid, sendbuf, 9);
+              zones_invalidate();
+              stream_release();
+              return 0; // Тест мог испортить содержимое буфера светодиодов
+            }
+          }
+          break;
+        case 'E': // Замер эффектов: 'T','E',first,frames,flags (бит 0 - выводить кадры на ленту).
+          // Эффекты, начиная с first, отрисовываются на всей ленте по frames кадров без ожидания кадра, сколько поместится в ответ
+          // и пока общее время не превысит BENCH_EFFECT_TIME_LIMIT (последний эффект может получить меньше кадров).
+          // Ответ: 't','e',led_lo,led_hi,frames,flags,<ef, кадров, отрисовка мин., сред., макс. (по 2), вывод сред., макс. (по 2)>...
+          // Время в тактах таймера 1 (TIMER_TICK_CYCLES тактов процессора)
+          if (reply_ready()) {
+            uint8_t ef = (wifiman_packet_len() >= 3) ? wifiman_read() : 255;
+            uint8_t frames = wifiman_read();
+            uint8_t flags = wifiman_read();
+            if (ef >= num_effects) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              BenchEffectResult res;
+              uint8_t space = reply_space();
+              uint8_t l = 6;
+              uint32_t left = BENCH_EFFECT_TIME_LIMIT;
+              do {
+                uint32_t spent = bench_effect(ef, frames, flags & 1, left, &res);
+                left = (spent < left) ? (left - spent) : 0;
+                sendbuf[l++] = ef++;
+                sendbuf[l++] = res.frames;
+                uint16_t v[] = {res.render_min, res.render_avg, res.render_max, res.out_avg, res.out_max};
+                for (uint8_t i = 0; i < (sizeof(v) / sizeof(v[0])); i++) {
+                  sendbuf[l++] = v[i];
+                  sendbuf[l++] = v[i] >> 8;
+                }
+              } while (left && (ef < num_effects) && ((l + 12) <= space)); // Запись об эффекте - 12 байт
+              sendbuf[0] = 't';
+              sendbuf[1] = 'e';
+              sendbuf[2] = (uint8_t)led_num;
+              sendbuf[3] = led_num >> 8;
+              sendbuf[4] = frames;
+              sendbuf[5] = flags;
+              reply_buf(linkid, sendbuf, l);
+              zones_invalidate();
+              stream_release();
+              return 0; // Описание зон и буфер светодиодов испорчены замером
+            }
+          }
+          break;
+      }
+      break;
+    case 'Z': // Зоны
+      switch (wifiman_read()) {
+        case 'R': // Чтение описания зон. Ответ: 'z','r',count,<записи по ZONE_REC_SIZE байт>
+          if (reply_ready()) {
+            uint8_t cnt = eeprom_read(EE_ZONES, 0);
+            if (cnt > MAX_ZONES) cnt = 0;
+            sendbuf[0] = 'z';
+            sendbuf[1] = 'r';
+            sendbuf[2] = cnt;
+            uint8_t l = cnt * ZONE_REC_SIZE;
+            for (uint8_t i = 0; i < l; i++) {
+              sendbuf[3 + i] = eeprom_read(EE_ZONES + 1 + i, 0xFF);
+            }
+            reply_buf(linkid, sendbuf, l + 3);
+          }
+          break;
+        case 'W': // Запись описания зон: 'Z','W',count,<записи по ZONE_REC_SIZE байт>. count = 0 - вся лента одной зоной
+          if (reply_ready()) {
+            uint8_t cnt = wifiman_packet_len() ? wifiman_read() : 255;
+            uint8_t l = cnt * ZONE_REC_SIZE;
+            if ((cnt > MAX_ZONES) || (l > wifiman_packet_len()) || ZONES_FIXED) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              uint8_t err = 0;
+              for (uint8_t i = 0; i < l; i += ZONE_REC_SIZE) {
+                for (uint8_t j = 0; j < ZONE_REC_SIZE; j++) {
+                  sendbuf[3 + i + j] = wifiman_read();
+                }
+                uint8_t * r = &sendbuf[3 + i];
+                if (!(r[2] | r[3]) || ((r[4] != ZONE_EFFECT_ROTATION) && (r[4] >= num_effects)) || !r[5]) err = 1;
+              }
+              if (err) {
+                reply_pgmz(linkid, &str_error);
+              } else {
+                eeprom_write(EE_ZONES, cnt);
+                for (uint8_t i = 0; i < l; i++) {
+                  eeprom_write(EE_ZONES + 1 + i, sendbuf[3 + i]);
+                }
+                sendbuf[0] = 'z';
+                sendbuf[1] = 'w';
+                sendbuf[2] = cnt;
+                reply_buf(linkid, sendbuf, 3);
+                zones_invalidate(); // Перед следующим кадром зоны будут построены заново
+              }
+            }
+          }
+          break;
+      }
+      break;
+    case 'G': // Геометрия: опорные точки расположения светодиодов на ёлке
+      switch (wifiman_read()) {
+        case 'R': // Чтение опорных точек. Ответ: 'g','r',count,<записи по GEO_ANCHOR_SIZE байт>. count = 0 - спираль по умолчанию
+          if (reply_ready()) {
+            uint8_t cnt = eeprom_read(EE_GEOMETRY, 0);
+            if ((cnt < 2) || (cnt > GEO_MAX_ANCHORS)) cnt = 0;
+            sendbuf[0] = 'g';
+            sendbuf[1] = 'r';
+            sendbuf[2] = cnt;
+            uint8_t l = cnt * GEO_ANCHOR_SIZE;
+            for (uint8_t i = 0; i < l; i++) {
+              sendbuf[3 + i] = eeprom_read(EE_GEOMETRY + 1 + i, 0xFF);
+            }
+            reply_buf(linkid, sendbuf, l + 3);
+          }
+          break;
+        case 'W': // Запись опорных точек: 'G','W',count,<записи по GEO_ANCHOR_SIZE байт>. Номера светодиодов должны возрастать
+          if (reply_ready()) {
+            uint8_t cnt = wifiman_packet_len() ? wifiman_read() : 255;
+            uint8_t l = cnt * GEO_ANCHOR_SIZE;
+            if ((cnt == 1) || (cnt > GEO_MAX_ANCHORS) || (l > wifiman_packet_len())) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              uint8_t err = 0;
+              uint16_t prev = 0;
+              for (uint8_t i = 0; i < l; i += GEO_ANCHOR_SIZE) {
+                for (uint8_t j = 0; j < GEO_ANCHOR_SIZE; j++) {
+                  sendbuf[3 + i + j] = wifiman_read();
+                }
+                uint16_t idx = sendbuf[3 + i] | (sendbuf[4 + i] << 8);
+                if (i && (idx <= prev)) err = 1;
+                prev = idx;
+              }
+              if (err) {
+                reply_pgmz(linkid, &str_error);
+              } else {
+                eeprom_write(EE_GEOMETRY, cnt);
+                for (uint8_t i = 0; i < l; i++) {
+                  eeprom_write(EE_GEOMETRY + 1 + i, sendbuf[3 + i]);
+                }
+                sendbuf[0] = 'g';
+                sendbuf[1] = 'w';
+                sendbuf[2] = cnt;
+                reply_buf(linkid, sendbuf, 3);
+              }
+            }
+          }
+          break;
+      }
+      break;
+    case 'C': // Палитры
+      switch (wifiman_read()) {
+        case 'C': // Количество палитр. Ответ: 'c','c',всего,из них встроенных (за ними идут PALETTE_USER пользовательских)
+          if (reply_ready()) {
+            sendbuf[0] = 'c';
+            sendbuf[1] = 'c';
+            sendbuf[2] = num_palettes;
+            sendbuf[3] = num_builtin_palettes;
+            reply_buf(linkid, sendbuf, 4);
+          }
+          break;
+        case 'D': // Название встроенной палитры
+          if (reply_ready()) {
+            uint8_t pn = wifiman_packet_len() ? wifiman_read() : 255;
+            if (pn >= num_builtin_palettes) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'c';
+              sendbuf[1] = 'd';
+              sendbuf[2] = pn;
+              uint8_t l = pgmz_to_buf(pgm_read_ptr(&palette_names[pn]), 4);
+              sendbuf[3] = l - 4;
+              reply_buf(linkid, sendbuf, l);
+            }
+          }
+          break;
+        case 'R': // Чтение палитры: 'C','R',n. Ответ: 'c','r',n,<PALETTE_STOPS троек r, g, b>
+          if (reply_ready()) {
+            uint8_t pn = wifiman_packet_len() ? wifiman_read() : 255;
+            if (pn >= num_palettes) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              sendbuf[0] = 'c';
+              sendbuf[1] = 'r';
+              sendbuf[2] = pn;
+              palette_load(pn, &sendbuf[3]);
+              reply_buf(linkid, sendbuf, PALETTE_DATA_SIZE + 3);
+            }
+          }
+          break;
+        case 'W': // Запись пользовательской палитры: 'C','W',slot,<PALETTE_STOPS троек r, g, b>
+          if (reply_ready()) {
+            uint8_t slot = (wifiman_packet_len() > PALETTE_DATA_SIZE) ? wifiman_read() : 255;
+            if (slot >= PALETTE_USER) {
+              reply_pgmz(linkid, &str_error);
+            } else {
+              uint16_t ee = EE_PALETTES + 1 + slot * PALETTE_DATA_SIZE;
+              for (uint8_t i = 0; i < PALETTE_DATA_SIZE; i++) {
+                eeprom_write(ee++, wifiman_read());
+              }
+              eeprom_write(EE_PALETTES, eeprom_read(EE_PALETTES, 0xFF) & ~(1 << slot));
+              sendbuf[0] = 'c';
+              sendbuf[1] = 'w';
+              sendbuf[2] = slot;
+              reply_buf(linkid, sendbuf, 3);
+              zones_invalidate(); // Эффекты загружают палитру при запуске: перед следующим кадром зоны запустятся заново
+            }
+          }
+          break;
+      }
+      break;
+    case 'V':
+      if (wifiman_read() == 'R') {
+        if (reply_ready()) {
+          PGM_VOID_P p = &version[8];
+          sendbuf[0] = 'v';
+          sendbuf[1] = 'r';
+          for (uint8_t i = 2; i < 18; i++) sendbuf[i] = pgm_read_byte(p++);
+          reply_buf(linkid, sendbuf, 18);
+        }              
+      }
+      break;
+      
+  }
+  return 1;
+}
+
+/* Обрабатывает пакет от клиента linkid. Возвращает 0, если отрисовку эффектов нужно прервать (см. process_command).
+ * Пакет команд: 'B', затем для каждой команды байт длины и сама команда. Ответ: 'b', затем для каждой выполненной команды
+ * байт длины её ответа (0 - ответа нет) и сам ответ. Команды выполняются, пока в буфере ответа есть место для REPLY_MAX байт,
+ * остальные отбрасываются - по количеству ответов клиент узнает, сколько команд выполнено */
+static uint8_t process_packet(uint8_t linkid) {
+  uint8_t cmd = wifiman_read();
+  if (cmd != 'B') return process_command(linkid, cmd);
+  uint8_t res = 1;
+  batch_ready = wifiman_ready();
+  reply_mem[0] = 'b';
+  batch_len = 1;
+  while (wifiman_packet_len() && ((batch_len + 1 + REPLY_MAX) <= sizeof(reply_mem))) {
+    uint16_t rest = wifiman_packet_limit(wifiman_read());
+    reply_mem[batch_len] = 0;
+    sendbuf = &reply_mem[batch_len + 1];
+    if (wifiman_packet_len()) {
+      cmd = wifiman_read();
+      if (cmd != 'B') res &= process_command(linkid, cmd);
+    }
+    batch_len += 1 + reply_mem[batch_len];
+    wifiman_packet_unlimit(rest);
+  }
+  sendbuf = reply_mem;
+  if (batch_ready) wifiman_send_buf(linkid, reply_mem, batch_len);
+  batch_len = 0;
+  return res;
 }
 
 /* Ожидает синхронизацию по таймеру, при этом обрабатывая wi-fi подключения
  * Если возвращает 0, значит процедура эффекта должна немедленно завершится и передать управление вызвавшей процедуре. При этом никаких изменений в оперативной памяти не допускается
  * */
 uint8_t wait_frame() {
-  ADCSRA |= (1 << ADSC);
   for(;;) {
     if (ymode) {
       if (wifiman_ready()) {
@@ -228,6 +1474,16 @@ uint8_t wait_frame() {
     }
     uint8_t r = wifiman_wait_frame();  
     if (!r) {
+      TRACE(TRACE_FRAME, 0);
+      adc_sample();
+      if (stream_pending) { // Последний собранный кадр выводится ровно по такту таймера
+        stream_present();
+        if (!power_down) {
+          immed_output();
+          if (!stream_pending) probe_output(); // При плавном переходе ('D','K') - только когда показан сам кадр
+        }
+      }
+      probe_reply();
       if (!(--one_second_countdown)) {
         one_second_countdown = DELAY_ONE_SECOND;
         // Операции, выполняющиеся раз в секунду.
@@ -259,6 +1515,7 @@ uint8_t wait_frame() {
         }
       }
       if (immed_countdown) immed_countdown--;
+      notify_frame();
       if (!effect_countdown) return 0; // Пора менять эффект
       effect_countdown--;
       if (external_control) return 0; // Лента управляется снаружи
@@ -268,473 +1525,58 @@ uint8_t wait_frame() {
     uint8_t linkid = r & PARSED_LINKID_MASK;
     if (tp == EVENT_SENT_ERROR) {
       ymode = 0;
+    } else if (tp == EVENT_DISCONNECT) {
+      notify_links &= ~(1 << linkid);
+      notify_pending &= ~(1 << linkid);
     } else if (tp == EVENT_CONNECT) {
       if (wifiman_ready()) {
         wifiman_send_pgmz(linkid, &str_hello);
       }
     } else if (tp == EVENT_PACKET) {
-      switch (wifiman_read()) {
-        case 'Y': 
-          if (checkpacketpgm(PSTR("OLKA_BLST"))) {
-            if (wifiman_ready()) {
-              wifiman_send_pgmz(linkid, &str_reconnect);
-              while (!wifiman_ready()) wifiman_pull();
-              wifiman_close(linkid);
-              wifiman_wait_outbuf();
-              run_bootloader();
-            }              
-          }
-          break;
-        case 'S':
-          if (checkpacketpgm(PSTR("ETMAGIC"))) {
-            if (wifiman_ready()) {
-              eeprom_write(EE_MAGIC, MAGIC_PROGRAMMED);
-              wifiman_send_pgmz(linkid, &str_magicok);
-            }              
-          }
-          break;
-        case 'D': {
-          uint8_t b = wifiman_read();
-          if ((b == 'H') || (b == 'L')) {
-            // Если у нас не идёт вывод на ленту, либо вывод идёт от этого же клиента, либо этот клиент запросил высокий приоритет, а вывод идёт с низким
-            if (!power_down && (!immed_countdown || ((immed_captured & 0x7F) == linkid) || ((b == 'H') && !(immed_captured & 0x80))))  {
-              uint8_t * p = (uint8_t*)&mem.leds;
-              for (uint16_t i = led_num * 3; i; i--) {
-                *(p++) = wifiman_read();
-              }
-              immed_captured = ((b == 'H') ? 0x80 : 00) | linkid;
-              immed_countdown = IMMED_COUNTDONW_INIT;
-              uint8_t sup = wifiman_suspend_cts();
-              led_data_out(&mem.leds, led_num);
-              wifiman_restore_cts(sup);
-              need_reoutput = 0;
-              external_control = 255;
-              return 0;
-            }            
-          }
-        } break;
-        case 'Q':
-          if (wifiman_read() == 'P') {
-            if (wifiman_ready()) {
-              cli(); // Делаем снимок отключив прерывания, чтобы значения случайно не изменились
-              uint16_t volt = adc_voltage;
-              uint16_t temp = adc_temp;
-              sei();
-              sendbuf[0] = 'q';
-              sendbuf[1] = 'p';
-              uint8_t sta = 0;
-              if (!power_down && (animation_mode != ANIMATION_POWER_OFF) && (animation_mode != ANIMATION_SLEEP)) sta |= 0x01; // Включено 
-              if (sleep_timer) sta |= 0x02; // Таймер спячки
-              if (wake_timer) sta |= 0x04; // Таймер пробуждения
-              if (external_control) sta |= 0x08; // Лента управляется снаружи
-              if (power_down | (immed_countdown && ((immed_captured & 0x7F) != linkid))) sta |= 0x10; // Вывод данных в низком приоритете будет проигнорирован
-              sendbuf[2] = sta;
-              sendbuf[3] = led_num;
-              sendbuf[4] = led_num >> 8;
-              sendbuf[5] = num_effects;
-              uint16_t rvolt = ((uint32_t)volt * adj_voltage + 32768) >> 16;
-              sendbuf[6] = rvolt;
-              sendbuf[7] = rvolt >> 8;
-              // 340 примерно соответствует 25 градусам??
-              sendbuf[8] = (temp >> 6) - 443  + adj_temp;
-              wifiman_send_buf(linkid, &sendbuf, 9);
-            }               
-          }
-          break;
-        case 'P': 
-          switch (wifiman_read()) {
-            case 'C': // Количество параметров
-              if (wifiman_ready() && !ymode) {
-                sendbuf[0] = 'p';
-                sendbuf[1] = 'c';
-                sendbuf[2] = sizeof(params_list) / sizeof(params_list[0]);
-                wifiman_send_buf(linkid, &sendbuf, 3);
-              }
-              break;
-            case 'D':  // Описание параметра
-              if (wifiman_ready()) {
-                uint8_t pn = wifiman_packet_len() ? wifiman_read() : 255;
-                if (pn >= (sizeof(params_list) / sizeof(params_list[0]))) {
-                  wifiman_send_pgmz(linkid, &str_error);
-                } else {
-                  sendbuf[0] = 'p';
-                  sendbuf[1] = 'd';
-                  sendbuf[2] = pn;
-                  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
-                  sendbuf[3] = pt;
-                  PGM_VOID_P param_name = pgm_read_ptr(&params_list[pn].name);
-                  uint8_t l = pgmz_to_buf(param_name, 5);
-                  sendbuf[4] = l - 5;
-                  if ((pt & 0xF0) == 0) {
-                    uint16_t min = pgm_read_word(&params_list[pn].min_ui);
-                    uint16_t max = pgm_read_word(&params_list[pn].max_ui);
-                    if (max) {
-                      if (pt == 0) {
-                        sendbuf[l++] = min;
-                        sendbuf[l++] = max;
-                      } else {
-                        sendbuf[l++] = min;
-                        sendbuf[l++] = min >> 8;
-                        sendbuf[l++] = max;
-                        sendbuf[l++] = max >> 8;
-                      }
-                    }
-                  }
-                  
-                  wifiman_send_buf(linkid, &sendbuf, l);
-                }
-              }
-              break;
-            case 'I':
-              if (wifiman_ready() && !ymode) {
-                wifiman_send_pgmz(linkid, PSTR("REINIT"));
-                ymode = YMODE_REINIT;
-              }
-              break;
-            case 'R':
-              if (wifiman_ready()) {
-                uint8_t pn = wifiman_packet_len() ? wifiman_read() : 255;
-                if (pn >= (sizeof(params_list) / sizeof(params_list[0]))) {
-                  wifiman_send_pgmz(linkid, &str_error);
-                } else {
-                  sendbuf[0] = 'p';
-                  sendbuf[1] = 'r';
-                  sendbuf[2] = pn;
-                  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
-                  uint16_t ee = pgm_read_word(&params_list[pn].ee_off);
-                  uint8_t l;
-                  if (pt & 0xF0) {
-                    uint8_t b = eeprom_read(ee++, 0xFF);
-                    l = 0;
-                    if (b != 0xFF) {
-                      uint8_t mx = (pt == PARAM_TYPE_STR_64) ? 64 : 32;
-                      while (b) {
-                        sendbuf[4 + l] = b;
-                        l++;
-                        if (l >= mx) break;
-                        b = eeprom_read(ee++, 0xFF);
-                      }
-                    } else { // Если параметр не задан, то пытаемся начитать и вернуть значение по-умолчанию
-                      PGM_VOID_P pdef = pgm_read_ptr(&params_list[pn].default_pp);
-                      if (pdef) {
-                        l = pgmz_to_buf(pdef, 4) - 4;
-                      }
-                    }                    
-                  } else {
-                    l = 1;
-                    sendbuf[4] = eeprom_read(ee++, 0xFF);
-                    if (pt == PARAM_TYPE_U16) {
-                      l = 2;
-                      sendbuf[5] = eeprom_read(ee++, 0xFF);
-                      if ((sendbuf[4] & sendbuf[5]) == 0xFF) {
-                        uint16_t def = pgm_read_word(&params_list[pn].default_ui);
-                        sendbuf[4] = def;
-                        sendbuf[5] = def >> 8;
-                      }
-                    } else {
-                      if (sendbuf[4] == 0xFF) {
-                        sendbuf[4] = pgm_read_byte(&params_list[pn].default_ui);
-                      }
-                    }
-                  }
-                  sendbuf[3] = l;
-                  wifiman_send_buf(linkid, &sendbuf, l + 4);
-                }
-              }
-              break;
-            case 'W': // установка параметра
-              if (wifiman_ready()) {
-                uint8_t pn = (wifiman_packet_len() >= 2) ? wifiman_read() : 255;
-                uint8_t l = wifiman_read();
-                if ((pn >= (sizeof(params_list) / sizeof(params_list[0]))) || (l > wifiman_packet_len())) {
-                  wifiman_send_pgmz(linkid, &str_error);
-                } else {
-                  sendbuf[0] = 'p';
-                  sendbuf[1] = 'w';
-                  sendbuf[2] = pn;
-                  uint8_t pt = pgm_read_byte(&params_list[pn].par_type);
-                  uint16_t ee = pgm_read_word(&params_list[pn].ee_off);
-                  uint8_t maxl = 1 << (pt & 0x0F);
-                  if ((l > maxl) || ((pt < 0x80) && l && (l != maxl))) {
-                    wifiman_send_pgmz(linkid, &str_error);
-                  } else {
-                    for (uint8_t i = 0; i < l; i++) {
-                      sendbuf[3 + i] = wifiman_read();
-                    }
-                    uint8_t err = 0;
-                    if (l) {
-                      if (pt >= 0x80) {
-                        if (sendbuf[3] == 0xFF) err = 1;
-                        for (uint8_t i = 0; i < l; i++) {
-                          if (sendbuf[i + 3] == 0x00) { 
-                            err = 1;
-                            break;
-                          }                                
-                        }
-                      } else {
-                        uint16_t v = (pt == PARAM_TYPE_U8) ? sendbuf[3] : (sendbuf[3] | (sendbuf[4] << 8));
-                        uint16_t min = pgm_read_word(&params_list[pn].min_ui);
-                        uint16_t max = pgm_read_word(&params_list[pn].max_ui);
-                        if (!max) max = (pt == PARAM_TYPE_U8) ? 254 : 65534;
-                        if ((v < min) || (v > max)) err = 1;
-                      }
-                    }                      
-                    if (err) {
-                      wifiman_send_pgmz(linkid, &str_error);
-                    } else {                    
-                      if (l) {
-                        for (uint8_t i = 0; i < l; i++) {
-                          eeprom_write(ee++, sendbuf[i + 3]);
-                        }
-                      }
-                      if (l < maxl) {
-                        uint8_t pl = l;
-                        if ((pt >= 0x80) && l) {
-                          eeprom_write(ee++, 0x00);
-                          pl++;
-                        }                        
-                        while (pl < maxl) {
-                          eeprom_write(ee++, 0xFF);
-                          pl++;
-                        }
-                      }                      
-                      switch (pn) {
-                        case PARAM_LED_NUM: 
-                          led_num = (l && (sendbuf[3] | sendbuf[4]) && ((sendbuf[3] | (sendbuf[4] << 8)) <= MAX_LED_COUNT)) ? (sendbuf[3] | (sendbuf[4] << 8)) : DEFAULT_LED_COUNT; 
-                          break;
-                        case PARAM_EFFECT_TIME: 
-                          par_effect_time = (l && sendbuf[3] && (sendbuf[3] < 255)) ? sendbuf[3] : DEFAULT_EFFECT_TIME; 
-                          break;
-                        case PARAM_EFFECT_TIME_ADD: 
-                          par_effect_time_add = (l && (sendbuf[3] < 255)) ? sendbuf[3] : DEFAULT_EFFECT_TIME_ADD; 
-                          break;
-                        case PARAM_VOLTAGE_ADJUST: 
-                          adj_voltage = (l && ((sendbuf[3] & sendbuf[4]) < 255)) ? (sendbuf[3] | (sendbuf[4] << 8)) : DEFAULT_VOLTAGE_ADJUST; 
-                          break;
-                        case PARAM_TEMP_ADJUST: 
-                          adj_temp = (l && (sendbuf[3] < 255)) ? sendbuf[3] : DEFAULT_TEMP_ADJUST; 
-                          break;
-                      }                    
-                      wifiman_send_buf(linkid, &sendbuf, 3);
-                    }                      
-                  }
-                }
-              }
-              break;
-          }
-          break;
-        case 'E': 
-          switch (wifiman_read()) {
-            case 'C': // Количество эффектов
-              if (wifiman_ready() && !ymode) {
-                sendbuf[0] = 'e';
-                sendbuf[1] = 'c';
-                sendbuf[2] = num_effects;
-                wifiman_send_buf(linkid, &sendbuf, 3);
-              }
-              break;
-            case 'D':  // Описание эффекта
-              if (wifiman_ready()) {
-                uint8_t efn = wifiman_packet_len() ? wifiman_read() : 255;
-                if (efn >= num_effects) {
-                  wifiman_send_pgmz(linkid, &str_error);
-                } else {
-                  sendbuf[0] = 'e';
-                  sendbuf[1] = 'd';
-                  sendbuf[2] = efn;
-                  PGM_VOID_P ef_name = pgm_read_ptr(&effects_list[efn].effect_name);
-                  uint8_t l = pgmz_to_buf(ef_name, 4);
-                  sendbuf[3] = l - 4;
-                  wifiman_send_buf(linkid, &sendbuf, l);
-                }
-              }
-              break;
-            case 'S': {
-              uint8_t efn = wifiman_packet_len() ? wifiman_read() : 255;
-              if (efn < num_effects) {
-                next_effect = efn;
-                if (external_control > 5) external_control = 5;
-                effect_countdown = 0;
-                if (wifiman_ready()) {
-                  sendbuf[0] = 'e';
-                  sendbuf[1] = 's';
-                  sendbuf[2] = efn;
-                  wifiman_send_buf(linkid, sendbuf, 3);
-                }
-              } else {
-                wifiman_send_pgmz(linkid, &str_error);
-              }
-            } break;
-          }
-          break;
-        case 'M': // Настройки настроения (яркости)
-          switch (wifiman_read()) {
-            case 'S': // Установка значения
-              if (wifiman_packet_len() < 3) {
-                wifiman_send_pgmz(linkid, &str_error);
-              }  else {
-                mood_brightness.r = wifiman_read();
-                mood_brightness.g = wifiman_read();
-                mood_brightness.b = wifiman_read();
-                recalculate_brightness();
-                sendbuf[0] = 'm';
-                sendbuf[1] = 's';
-                sendbuf[2] = mood_brightness.r;
-                sendbuf[3] = mood_brightness.g;
-                sendbuf[4] = mood_brightness.b;
-                wifiman_send_buf(linkid, &sendbuf, 5);
-              }            
-              break;
-            case 'R': // Чтенение значений яркости
-              sendbuf[0] = 'm';
-              sendbuf[1] = 'r';
-              sendbuf[2] = mood_brightness.r;
-              sendbuf[3] = mood_brightness.g;
-              sendbuf[4] = mood_brightness.b;
-              wifiman_send_buf(linkid, &sendbuf, 5);
-              break;
-          }          
-          break;
-        case 'W': 
-          if (wifiman_packet_len() >= 18) {
-            for (uint8_t i = 0; i < 18; i++) {
-              sendbuf[i] = wifiman_read();
-            }
-            uint8_t x = 5;
-            for (int i = 17; i >= 0; i--) {
-              x = (sendbuf[i] * 11) ^ x;
-              sendbuf[i] = x;
-            }
-            static const PROGMEM uint8_t xtbl[] = { 0xC4, 0x46, 0x14, 0xEF, 0x47, 0xFF, 0xC9, 0x8B, 0xDD, 0xAB, 0xFA, 0x28, 0x63, 0x3B, 0xB8, 0x29, 0xE6, 0xCF};
-            x = 83;
-            for (uint8_t i = 0; i < 18; i++) {
-              x = (pgm_read_byte(&xtbl[i]) ^ ((sendbuf[i] * 5) & 0xFF)) + x * 3;
-              sendbuf[i] = x;
-            }
-            if (!x) wifiman_send_buf(linkid, &sendbuf, 17);
-          }          
-          break;
-        case 'L': // Настройки управления питанием (яркости)
-          switch (wifiman_read()) {
-            case 'R': // Чтенение состояния 
-              sendbuf[0] = 'l';
-              sendbuf[1] = 'r';
-              sendbuf[2] = ((power_down) || (animation_mode == ANIMATION_SLEEP) || (animation_mode == ANIMATION_POWER_OFF)) ? 0 : 1;
-              sendbuf[3] = wake_timer;
-              sendbuf[4] = wake_timer >> 8;
-              sendbuf[5] = sleep_timer;
-              sendbuf[6] = sleep_timer >> 8;
-              wifiman_send_buf(linkid, &sendbuf, 7);
-              break;
-            case 'O': // Управление питанием
-              if (wifiman_packet_len() < 1) {
-                wifiman_send_pgmz(linkid, &str_error);
-              } else {
-                uint8_t p = wifiman_read();
-                if ((p != 0) && (p != 1)) {
-                  wifiman_send_pgmz(linkid, &str_error);
-                } else {
-                  if (!p) {
-                    animation_mode = ANIMATION_POWER_OFF;
-                    // Таймер сна не отменяется, если он настроен ЗА таймером пробуждения
-                    if (!wake_timer || (sleep_timer <= wake_timer)) sleep_timer = 0;
-                  } else {
-                    power_down = 0;
-                    animation_mode = ANIMATION_POWER_ON;
-                    // Таймер пробуждения не отменяется, если он настроен ЗА таймером сна
-                    if (!sleep_timer || (wake_timer <= sleep_timer)) wake_timer = 0;
-                  }
-                  sendbuf[0] = 'l';
-                  sendbuf[1] = 'o';
-                  sendbuf[2] = p;
-                  wifiman_send_buf(linkid, &sendbuf, 3);
-                }
-              }            
-              break;
-            case 'W': // Установка таймера пробуждения
-              if (wifiman_packet_len() < 2) {
-                wifiman_send_pgmz(linkid, &str_error);
-              } else {
-                uint16_t wt = wifiman_read() | (wifiman_read() << 8);
-                wake_timer = wt;
-                
-                if (wt) {
-                  if (!power_down && (!sleep_timer || (wt < sleep_timer))) {
-                    animation_mode = ANIMATION_POWER_OFF;
-                  }
-                }
-                sendbuf[0] = 'l';
-                sendbuf[1] = 'w';
-                sendbuf[2] = wt;
-                sendbuf[3] = wt >> 8;
-                wifiman_send_buf(linkid, &sendbuf, 4);
-              }            
-              break;
-            case 'S': // Установка таймера сна
-              if (wifiman_packet_len() < 2) {
-                wifiman_send_pgmz(linkid, &str_error);
-              } else {
-                uint16_t st = wifiman_read() | (wifiman_read() << 8);
-                sleep_timer = st;
-                
-                if (st) {
-                  if (!wake_timer || (st < wake_timer)) {
-                    power_down = 0;
-                    animation_mode = ANIMATION_POWER_ON;
-                  }
-                }
-                sendbuf[0] = 'l';
-                sendbuf[1] = 's';
-                sendbuf[2] = st;
-                sendbuf[3] = st >> 8;
-                wifiman_send_buf(linkid, &sendbuf, 4);
-              }            
-              break;
-          }          
-          break;
-        case 'V':
-          if (wifiman_read() == 'R') {
-            if (wifiman_ready()) {
-              PGM_VOID_P p = &version[8];
-              sendbuf[0] = 'v';
-              sendbuf[1] = 'r';
-              for (uint8_t i = 2; i < 18; i++) sendbuf[i] = pgm_read_byte(p++);
-              wifiman_send_buf(linkid, sendbuf, 18);
-            }              
-          }
-          break;
-          
-      }
+      if (!process_packet(linkid)) return 0;
     }
   }
 }
 
 
+/* Регулятор кадров. Вызывается перед ожиданием следующего кадра эффекта: время от начала кадра - это вывод на ленту и отрисовка.
+ * Раз в GOV_WINDOW кадров решает, нужно ли понизить или можно ли повысить частоту отрисовки эффектов */
+static void governor_account() {
+  uint16_t work = wifiman_time() - frame_start;
+  uint16_t budget = frame_divider * TIMER_TICKS_PER_FRAME - ZONES_FRAME_RESERVE;
+  if (work > budget) {
+    gov_over++;
+  } else if ((work + TIMER_TICKS_PER_FRAME + ZONES_FRAME_RESERVE) <= budget) {
+    gov_fit++;
+  }
+  if (++gov_frames < GOV_WINDOW) return;
+  if (gov_over >= GOV_UP) {
+    if (frame_divider < GOV_MAX_DIVIDER) frame_divider++;
+    gov_calm = 0;
+  } else if ((frame_divider > 1) && (gov_fit == gov_frames)) {
+    if (++gov_calm >= GOV_CALM) {
+      frame_divider--;
+      gov_calm = 0;
+    }
+  } else {
+    gov_calm = 0;
+  }
+  gov_frames = 0;
+  gov_over = 0;
+  gov_fit = 0;
+}
+
 /* Дожидается синхронизации кадра, выводит информацию из буфера на строку светодиодов 
  * Если возвращает 0, значит процедура эффекта должна немедленно завершится и передать управление вызвавшей процедуре. При этом никаких изменений в оперативной памяти не допускается
  * */
 uint8_t sync_out(void * led_data) {
-  if (!wait_frame()) return 0;
+  governor_account();
+  for (uint8_t d = frame_divider; d; d--) {
+    if (!wait_frame()) return 0;
+  }
+  frame_start = wifiman_time();
   if (power_down) return 0;
-  uint8_t sup = wifiman_suspend_cts();
-  led_data_out(led_data, led_num);
-  wifiman_restore_cts(sup);
-  need_reoutput = 0;
-  return 1;
-}
-
-/* Дожидается синхронизации кадра, выводит информацию из буфера на строку светодиодов, затме пропускает указанное число кадров
- * Если возвращает 0, значит процедура эффекта должна немедленно завершится и передать управление вызвавшей процедуре. При этом никаких изменений в оперативной памяти не допускается
- * */
-uint8_t sync_out_pause(void * led_data, uint8_t skip_frames) {
-  if (!sync_out(led_data)) return 0;
-  while (skip_frames--) {
-    if (need_reoutput) {
-      if (!sync_out(led_data)) return 0;
-    } else {
-      if (!wait_frame()) return 0;
-    }
-  }   
+  strip_output(led_data);
   return 1;
 }
 
@@ -781,53 +1623,69 @@ int main(void)
     }
   }
   random_seed.u32 ^= seedxor;
+  fastrnd_seed(random_seed.u32);
   
   adj_voltage = eeprom_read_uint16(EE_VOLTAGE_ADJUST, DEFAULT_VOLTAGE_ADJUST);
   adj_temp = eeprom_read(EE_TEMP_ADJUST, DEFAULT_TEMP_ADJUST);
   
+#ifndef FIXED_LED_COUNT
   led_num = eeprom_read_uint16(EE_LED_NUM, DEFAULT_LED_COUNT);
   
   if (led_num > MAX_LED_COUNT) {
     eeprom_write(EE_LED_NUM + 1, 0);
     led_num &= 0xFF;
   }    
+#endif
   
   par_effect_time = eeprom_read(EE_EFFECT_TIME, DEFAULT_EFFECT_TIME);
   if (par_effect_time < 1) par_effect_time = DEFAULT_EFFECT_TIME;
   par_effect_time_add = eeprom_read(EE_EFFECT_TIME_ADD, DEFAULT_EFFECT_TIME_ADD);
   
   
-  ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0); // прескалер 1:128 - 125 000 кГц ~= 9000 замеров в секунду
+  ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0); // прескалер 1:128 - 125 000 кГц
+  // Первые 64 + 64 замера набираются сразу (около 14 мс), чтобы напряжение и температура были известны с первого кадра.
+  // Дальше - по замеру в кадр, см. adc_sample
+  for (uint8_t i = 128; i; i--) {
+    while (ADCSRA & (1 << ADSC));
+    adc_sample();
+  }
 
   sei();
   
   
   
-  void(*fx)(void);
-  
   next_effect = random(num_effects);
   
   while(1) {
-    uint8_t ef = next_effect;
-    if (!effect_countdown) {
-      if (num_effects > 1) {
-        next_effect = random(num_effects - 1);
-        if (next_effect >= ef) next_effect++;
+    uint8_t ef;
+    if (effect_restart) { // Перезапуск показываемого эффекта, очередь эффектов и время показа не меняются
+      effect_restart = 0;
+      ef = current_effect;
+    } else {
+      ef = next_effect;
+      current_effect = ef;
+      if (!effect_countdown) {
+        if (num_effects > 1) {
+          next_effect = random(num_effects - 1);
+          if (next_effect >= ef) next_effect++;
+        }
+        effect_countdown = par_effect_time * 50 + randomw(par_effect_time_add * 50);
       }
-      effect_countdown = par_effect_time * 50 + randomw(par_effect_time_add * 50);
-    }      
-    
-    fx = pgm_read_ptr(&effects_list[ef].effect);
-    fx();
+    }
+
+    zones_start(ef);
+    frame_start = wifiman_time();
+    do {
+      uint16_t t = wifiman_time();
+      zones_render();
+      t = wifiman_time() - t;
+      if (t > frame_stats.render_max) frame_stats.render_max = t;
+    } while (sync_out(&mem.leds));
     while (external_control || power_down) {
       if (external_control) external_control--;
       wait_frame();
       if (need_reoutput) {
-        if (!power_down) {
-          uint8_t sup = wifiman_suspend_cts();
-          led_data_out(&mem.leds, led_num);
-          wifiman_restore_cts(sup);
-        }        
+        if (!power_down) strip_output(&mem.leds);
         need_reoutput = 0;
       }
     }
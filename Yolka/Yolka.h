@@ -13,7 +13,16 @@
 
 #include "ws2812.h"
 
-#define MAX_LED_COUNT 512 // Максимально допустимое количество светодиодов
+/* Если FIXED_LED_COUNT задано, количество светодиодов фиксируется при сборке: параметр "Number Of LEDs" может принимать
+ * только это значение, буфер ленты имеет точно такой размер, а в эффектах деления на длину ленты становятся константными, 
+ * счётчики циклов - 8 битными (если светодиодов меньше 256). Зоны при этом не поддерживаются: вся лента - одна зона. */
+//#define FIXED_LED_COUNT 150
+
+#ifdef FIXED_LED_COUNT
+  #define MAX_LED_COUNT FIXED_LED_COUNT
+#else
+  #define MAX_LED_COUNT 512 // Максимально допустимое количество светодиодов
+#endif
 
 #define DEFAULT_LED_COUNT 50 // Количество светодиодов, по-умолчанию 
 
@@ -53,6 +62,38 @@
 
 #define IMMED_COUNTDONW_INIT 25 // Количество кадров (т.е. периодов 1/50 секунды) после вывода данных от клиента, в течение которых данные с тем же приоритетом от других подключившихся будут игнорироваться
 
+#define REPLY_MAX 68 // Максимальная длина ответа на одну команду
+#define BATCH_EXTRA 32 // Место в буфере ответа сверх REPLY_MAX, в котором собираются ответы на пакет команд 'B'
+
+// Счётчики производительности основного цикла, время - в тактах таймера 1 (16 мкс)
+typedef struct {
+  uint16_t render_max; // Наибольшее время отрисовки кадра эффектами
+  uint16_t out_max; // Наибольшее время вывода на ленту
+} FrameStats;
+
+extern FrameStats frame_stats;
+
+/* Регулятор кадров: если вывод на ленту и отрисовка не укладываются в кадр, эффекты переходят на отрисовку раз в frame_divider
+ * тактов таймера. Таймеры, смена эффектов, анимации яркости и потоковые кадры ('D') по-прежнему идут с частотой 50 Гц */
+#define GOV_MAX_DIVIDER 4 // Наибольший делитель частоты кадров эффектов
+#define GOV_WINDOW 25 // Кадров эффекта в окне оценки
+#define GOV_UP 3 // Перегруженных кадров в окне, при котором частота понижается
+#define GOV_CALM 8 // Окон подряд с запасом времени на целый кадр, после которых частота повышается
+
+extern uint8_t frame_divider;
+
+// Состояния замера задержки вывода ('R','F')
+#define PROBE_IDLE 0
+#define PROBE_TAGGED 1 // Ожидается завершение кадра
+#define PROBE_COMMITTED 2 // Кадр завершён, ожидается его вывод
+#define PROBE_DONE 3 // Задержка измерена, ожидается отправка ответа
+
+#define NOTIFY_INTERVAL 5 // Наименьший промежуток в кадрах между уведомлениями одному клиенту
+#define NOTIFY_VOLT_STEP 100 // Изменение напряжения, о котором уведомляются подписчики
+#define NOTIFY_TEMP_STEP 2 // Изменение температуры, о котором уведомляются подписчики
+
+#define STREAM_FLAG_COMMIT 0x01 // Флаг части кадра 'D','S': кадр собран, вывести его на ленту
+
 
 // Различные виды анимаций (нарастание/затухание яркости)
 #define ANIMATION_WAKE 1
@@ -67,7 +108,21 @@
 #define POWER_OFF_SPEED 8
 
 // Количество светодиодов в линейке
-extern uint16_t led_num;
+#ifdef FIXED_LED_COUNT
+  #define led_num ((uint16_t)FIXED_LED_COUNT)
+#else
+  extern uint16_t led_num;
+#endif
+
+// Тип для номера светодиода в ленте, достаточный для хранения led_num
+#if defined(FIXED_LED_COUNT) && (FIXED_LED_COUNT < 256)
+  typedef uint8_t led_idx_t;
+#else
+  typedef uint16_t led_idx_t;
+#endif
+
+// Обратный счётчик времени (в кадрах) до переключения эффекта. Эффект может обнулить его, чтобы его сразу сменил следующий
+extern uint16_t effect_countdown;
 
 /* Ожидает синхронизацию по таймеру, при этом обрабатывая wi-fi подключения
  * Если возвращает 0, значит процедура эффекта должна немедленно завершится и передать управление вызвавшей процедуре. При этом никаких изменений в оперативной памяти не допускается
@@ -79,11 +134,6 @@ uint8_t wait_frame();
  * */
 uint8_t sync_out(void * led_data);
 
-/* Дожидается синхронизации кадра, выводит информацию из буфера на строку светодиодов, затме пропускает указанное число кадров
- * Если возвращает 0, значит процедура эффекта должна немедленно завершиться и передать управление вызвавшей процедуре. При этом никаких изменений в оперативной памяти не допускается
- * */
-uint8_t sync_out_pause(void * led_data, uint8_t skip_frames);
-
 
 /* Возвращает 16битное случайное число */
 uint16_t random16();
@@ -0,0 +1,107 @@
+﻿/*
+ * anim.c
+ *
+ * Проигрыватель анимаций, заранее подготовленных и размещённых во флеш-памяти, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "anim.h"
+#include "anim_data.h"
+#include "effects.h"
+#include "Yolka.h"
+
+typedef struct {
+  const uint8_t * p; // Начало следующего кадра
+  uint16_t fn; // Номер следующего кадра
+  uint8_t wait; // Сколько ещё кадров показывать текущий
+} AnimState;
+EFFECT_STATE_CHECK(AnimState);
+
+/* Декодирует очередной кадр в зону z. Светодиоды за пределами зоны пропускаются.
+ * Возвращает указатель на начало следующего кадра */
+static const uint8_t * anim_decode_frame(const uint8_t * p, const uint8_t * pal, uint16_t anim_leds, EffectZone * z) {
+  p++; // Флаги кадра. Ключевой кадр перерисовывает все светодиоды, поэтому отдельно не обрабатывается
+  led_rec * led = z->leds;
+  uint16_t lim = (anim_leds < z->num) ? anim_leds : z->num;
+  uint16_t i = 0;
+  while (i < anim_leds) {
+    uint8_t op = pgm_read_byte(p++);
+    uint8_t n;
+    if (op < ANIM_OP_RUN) { // Пропуск
+      n = op + 1;
+      led += n;
+      i += n;
+      continue;
+    }
+    if (op < ANIM_OP_LITERAL) { // Повтор одного цвета
+      n = (op & 0x3F) + 1;
+      const uint8_t * c = pal + pgm_read_byte(p++) * 3;
+      uint8_t r = pgm_read_byte(c);
+      uint8_t g = pgm_read_byte(c + 1);
+      uint8_t b = pgm_read_byte(c + 2);
+      for (; n; n--) {
+        if (i < lim) {
+          led->r = r;
+          led->g = g;
+          led->b = b;
+        }
+        led++;
+        i++;
+      }
+    } else { // Последовательность цветов
+      n = (op & 0x7F) + 1;
+      for (; n; n--) {
+        const uint8_t * c = pal + pgm_read_byte(p++) * 3;
+        if (i < lim) {
+          led->r = pgm_read_byte(c);
+          led->g = pgm_read_byte(c + 1);
+          led->b = pgm_read_byte(c + 2);
+        }
+        led++;
+        i++;
+      }
+    }
+  }
+  return p;
+}
+
+void anim_play(EffectZone * z, PGM_VOID_P anim) {
+  AnimState * s = EFFECT_STATE(z, AnimState);
+  const uint8_t * hdr = anim;
+  uint16_t anim_leds = pgm_read_word(hdr);
+  uint16_t frames = pgm_read_word(hdr + 2);
+  uint8_t ticks = pgm_read_byte(hdr + 4);
+  uint8_t pal_cnt = pgm_read_byte(hdr + 5);
+  const uint8_t * pal = hdr + ANIM_HEADER_SIZE;
+  const uint8_t * first = pal + (pal_cnt ? pal_cnt : 256) * 3;
+  if (z->init) {
+    clear(z->leds, z->num);
+    s->p = first;
+    s->fn = 0;
+    s->wait = 0;
+  }
+  if (s->wait) { // Кадр ещё не сменился, изображение в буфере остаётся прежним
+    s->wait--;
+    return;
+  }
+  s->wait = ticks ? (ticks - 1) : 0;
+  if (s->fn >= frames) {
+    s->fn = 0;
+    s->p = first;
+  }
+  s->p = anim_decode_frame(s->p, pal, anim_leds, z);
+  s->fn++;
+  // Если зона длиннее анимации, то повторяем её
+  led_rec * src = z->leds;
+  led_rec * dst = &z->leds[anim_leds];
+  for (uint16_t i = anim_leds; i < z->num; i++) {
+    *(dst++) = *(src++);
+  }
+}
+
+void anim_twinkle_effect(EffectZone * z) {
+  anim_play(z, anim_twinkle);
+}
@@ -0,0 +1,45 @@
+﻿/*
+ * anim.h
+ *
+ * Проигрыватель анимаций, заранее подготовленных и размещённых во флеш-памяти, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef ANIM_H_
+#define ANIM_H_
+
+#include <avr/pgmspace.h>
+#include "effects.h"
+
+/* Формат анимации (генерируется утилитой Tools/animconv.py):
+ * Заголовок:
+ *   leds_lo, leds_hi - количество светодиодов в кадре
+ *   frames_lo, frames_hi - количество кадров
+ *   ticks - длительность кадра, в периодах 1/50 секунды
+ *   pal_cnt - количество цветов в палитре (0 соответствует 256)
+ * Палитра: pal_cnt троек r, g, b
+ * Далее кадры. Каждый кадр начинается с байта флагов (ANIM_FRAME_KEY - ключевой кадр, не ссылается на предыдущий),
+ * затем идут команды, пока не будут описаны все светодиоды кадра:
+ *   0x00..0x3F - пропустить (n & 0x3F) + 1 светодиодов, оставив цвет из предыдущего кадра
+ *   0x40..0x7F, c - (n & 0x3F) + 1 светодиодов цветом c из палитры
+ *   0x80..0xFF, c1, c2... - (n & 0x7F) + 1 светодиодов, каждый своим цветом из палитры
+ */
+
+#define ANIM_HEADER_SIZE 6
+
+#define ANIM_FRAME_KEY 0x01
+
+#define ANIM_OP_SKIP 0x00
+#define ANIM_OP_RUN 0x40
+#define ANIM_OP_LITERAL 0x80
+
+/* Отрисовывает очередной кадр анимации в зоне z. Анимация проигрывается по кругу.
+ * Если светодиодов в зоне больше, чем в анимации, то анимация повторяется по всей длине */
+void anim_play(EffectZone * z, PGM_VOID_P anim);
+
+// Эффекты, проигрывающие встроенные анимации
+void anim_twinkle_effect(EffectZone * z);
+
+#endif /* ANIM_H_ */
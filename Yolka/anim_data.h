@@ -0,0 +1,137 @@
+﻿/*
+ * anim_data.h
+ *
+ * Данные анимаций, проект "Ёлка"
+ * Файл сгенерирован утилитой Tools/animconv.py, вручную не редактировать:
+ *   python animconv.py -n anim_twinkle --fps 25 anim/twinkle.png
+ */ 
+
+
+#ifndef ANIM_DATA_H_
+#define ANIM_DATA_H_
+
+#include <avr/pgmspace.h>
+
+// anim_twinkle: 50 LEDs, 64 frames, 2 ticks per frame, 5 colors. 1884 bytes (raw RGB 9600 bytes)
+const PROGMEM uint8_t anim_twinkle[] = {
+  0x32, 0x00, 0x40, 0x00, 0x02, 0x05, 0x18, 0x08, 0x00, 0x50, 0x28, 0x06, 0xA0, 0x60, 0x18, 0xFF,
+  0xC8, 0x5A, 0xFF, 0xF0, 0xC8, 0x01, 0x47, 0x00, 0x80, 0x01, 0x68, 0x00, 0x00, 0x05, 0x80, 0x01,
+  0x00, 0x80, 0x02, 0x13, 0x80, 0x01, 0x13, 0x00, 0x05, 0x80, 0x02, 0x00, 0x81, 0x03, 0x01, 0x12,
+  0x80, 0x02, 0x03, 0x80, 0x01, 0x02, 0x80, 0x01, 0x0A, 0x00, 0x05, 0x83, 0x03, 0x01, 0x04, 0x02,
+  0x03, 0x80, 0x01, 0x0D, 0x80, 0x03, 0x03, 0x80, 0x02, 0x02, 0x82, 0x02, 0x01, 0x01, 0x08, 0x00,
+  0x05, 0x83, 0x04, 0x02, 0x03, 0x03, 0x03, 0x80, 0x02, 0x0D, 0x80, 0x04, 0x03, 0x80, 0x03, 0x02,
+  0x82, 0x03, 0x02, 0x02, 0x05, 0x80, 0x01, 0x01, 0x00, 0x05, 0x83, 0x03, 0x03, 0x02, 0x04, 0x03,
+  0x80, 0x03, 0x0C, 0x81, 0x01, 0x03, 0x01, 0x80, 0x01, 0x00, 0x80, 0x04, 0x02, 0x82, 0x04, 0x03,
+  0x03, 0x05, 0x80, 0x02, 0x01, 0x00, 0x05, 0x83, 0x02, 0x04, 0x00, 0x03, 0x03, 0x80, 0x04, 0x0C,
+  0x81, 0x02, 0x02, 0x01, 0x80, 0x02, 0x00, 0x80, 0x03, 0x02, 0x82, 0x03, 0x04, 0x04, 0x05, 0x80,
+  0x03, 0x01, 0x00, 0x05, 0x81, 0x00, 0x03, 0x00, 0x80, 0x02, 0x03, 0x80, 0x03, 0x01, 0x80, 0x01,
+  0x01, 0x80, 0x01, 0x06, 0x80, 0x03, 0x42, 0x00, 0x82, 0x03, 0x01, 0x02, 0x02, 0x82, 0x02, 0x03,
+  0x03, 0x05, 0x80, 0x04, 0x01, 0x00, 0x06, 0x80, 0x02, 0x00, 0x44, 0x00, 0x80, 0x02, 0x01, 0x80,
+  0x02, 0x01, 0x80, 0x02, 0x06, 0x80, 0x04, 0x02, 0x81, 0x04, 0x02, 0x44, 0x00, 0x81, 0x02, 0x02,
+  0x01, 0x80, 0x01, 0x00, 0x80, 0x01, 0x00, 0x80, 0x03, 0x01, 0x00, 0x06, 0x49, 0x00, 0x80, 0x03,
+  0x01, 0x80, 0x03, 0x06, 0x80, 0x03, 0x02, 0x81, 0x03, 0x03, 0x04, 0x43, 0x00, 0x80, 0x02, 0x00,
+  0x80, 0x02, 0x00, 0x80, 0x02, 0x01, 0x00, 0x02, 0x80, 0x01, 0x04, 0x80, 0x01, 0x03, 0x80, 0x01,
+  0x01, 0x80, 0x04, 0x01, 0x80, 0x04, 0x06, 0x80, 0x02, 0x02, 0x81, 0x02, 0x04, 0x08, 0x80, 0x03,
+  0x00, 0x80, 0x03, 0x00, 0x42, 0x00, 0x00, 0x02, 0x80, 0x02, 0x00, 0x80, 0x01, 0x02, 0x80, 0x02,
+  0x03, 0x80, 0x02, 0x01, 0x81, 0x03, 0x01, 0x00, 0x80, 0x03, 0x06, 0x44, 0x00, 0x80, 0x03, 0x08,
+  0x80, 0x04, 0x00, 0x80, 0x04, 0x03, 0x00, 0x01, 0x81, 0x01, 0x03, 0x00, 0x80, 0x02, 0x02, 0x80,
+  0x03, 0x03, 0x80, 0x03, 0x01, 0x81, 0x02, 0x02, 0x00, 0x80, 0x02, 0x02, 0x80, 0x01, 0x07, 0x80,
+  0x02, 0x08, 0x80, 0x03, 0x00, 0x80, 0x03, 0x01, 0x81, 0x01, 0x01, 0x00, 0x01, 0x81, 0x02, 0x04,
+  0x00, 0x80, 0x03, 0x02, 0x80, 0x04, 0x00, 0x80, 0x01, 0x01, 0x80, 0x04, 0x01, 0x81, 0x00, 0x03,
+  0x00, 0x43, 0x00, 0x80, 0x02, 0x07, 0x49, 0x00, 0x80, 0x02, 0x00, 0x80, 0x02, 0x01, 0x81, 0x02,
+  0x02, 0x00, 0x01, 0x81, 0x03, 0x03, 0x00, 0x80, 0x04, 0x02, 0x80, 0x03, 0x00, 0x80, 0x02, 0x01,
+  0x80, 0x03, 0x02, 0x80, 0x04, 0x04, 0x80, 0x03, 0x11, 0x44, 0x00, 0x81, 0x03, 0x03, 0x00, 0x01,
+  0x81, 0x04, 0x02, 0x00, 0x80, 0x03, 0x02, 0x80, 0x02, 0x00, 0x80, 0x03, 0x01, 0x80, 0x02, 0x02,
+  0x80, 0x03, 0x04, 0x80, 0x04, 0x06, 0x81, 0x01, 0x01, 0x03, 0x80, 0x01, 0x08, 0x81, 0x04, 0x04,
+  0x00, 0x01, 0x81, 0x03, 0x00, 0x00, 0x80, 0x02, 0x02, 0x80, 0x00, 0x00, 0x81, 0x04, 0x01, 0x00,
+  0x43, 0x00, 0x80, 0x02, 0x04, 0x80, 0x03, 0x06, 0x82, 0x02, 0x02, 0x01, 0x02, 0x80, 0x02, 0x07,
+  0x82, 0x01, 0x03, 0x03, 0x00, 0x01, 0x80, 0x02, 0x01, 0x43, 0x00, 0x80, 0x01, 0x00, 0x81, 0x03,
+  0x02, 0x04, 0x45, 0x00, 0x80, 0x02, 0x06, 0x82, 0x03, 0x03, 0x02, 0x02, 0x80, 0x03, 0x07, 0x42,
+  0x02, 0x00, 0x01, 0x46, 0x00, 0x80, 0x02, 0x00, 0x81, 0x02, 0x03, 0x00, 0x80, 0x01, 0x04, 0x80,
+  0x01, 0x02, 0x47, 0x00, 0x82, 0x04, 0x04, 0x03, 0x02, 0x80, 0x04, 0x03, 0x80, 0x01, 0x02, 0x82,
+  0x03, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x06, 0x80, 0x03, 0x00, 0x81, 0x00, 0x04, 0x00, 0x80,
+  0x02, 0x03, 0x81, 0x01, 0x02, 0x03, 0x80, 0x01, 0x05, 0x82, 0x03, 0x03, 0x04, 0x02, 0x80, 0x03,
+  0x03, 0x80, 0x02, 0x02, 0x80, 0x04, 0x01, 0x00, 0x00, 0x80, 0x02, 0x04, 0x80, 0x01, 0x00, 0x80,
+  0x04, 0x01, 0x80, 0x03, 0x00, 0x80, 0x03, 0x03, 0x81, 0x02, 0x03, 0x03, 0x80, 0x02, 0x05, 0x82,
+  0x02, 0x02, 0x03, 0x02, 0x80, 0x02, 0x03, 0x80, 0x03, 0x02, 0x80, 0x03, 0x01, 0x00, 0x00, 0x80,
+  0x03, 0x04, 0x80, 0x02, 0x00, 0x80, 0x03, 0x01, 0x80, 0x02, 0x00, 0x80, 0x04, 0x03, 0x81, 0x03,
+  0x04, 0x03, 0x80, 0x03, 0x05, 0x82, 0x00, 0x00, 0x02, 0x02, 0x44, 0x00, 0x80, 0x04, 0x02, 0x80,
+  0x02, 0x01, 0x00, 0x00, 0x81, 0x04, 0x01, 0x03, 0x80, 0x03, 0x00, 0x80, 0x02, 0x01, 0x80, 0x00,
+  0x00, 0x80, 0x03, 0x03, 0x81, 0x04, 0x03, 0x03, 0x80, 0x04, 0x07, 0x45, 0x00, 0x80, 0x01, 0x01,
+  0x80, 0x03, 0x02, 0x42, 0x00, 0x00, 0x82, 0x01, 0x03, 0x02, 0x03, 0x80, 0x04, 0x00, 0x44, 0x00,
+  0x80, 0x02, 0x03, 0x81, 0x03, 0x02, 0x03, 0x80, 0x03, 0x0D, 0x80, 0x02, 0x01, 0x80, 0x02, 0x05,
+  0x00, 0x82, 0x02, 0x02, 0x03, 0x03, 0x80, 0x03, 0x00, 0x80, 0x01, 0x03, 0x44, 0x00, 0x80, 0x02,
+  0x44, 0x00, 0x81, 0x02, 0x01, 0x0C, 0x80, 0x03, 0x01, 0x46, 0x00, 0x00, 0x82, 0x03, 0x00, 0x04,
+  0x03, 0x80, 0x02, 0x00, 0x80, 0x02, 0x08, 0x46, 0x00, 0x80, 0x02, 0x0A, 0x80, 0x01, 0x00, 0x80,
+  0x04, 0x08, 0x00, 0x80, 0x04, 0x00, 0x80, 0x03, 0x03, 0x80, 0x00, 0x00, 0x80, 0x03, 0x0F, 0x80,
+  0x03, 0x03, 0x81, 0x01, 0x01, 0x04, 0x80, 0x02, 0x00, 0x80, 0x03, 0x01, 0x81, 0x01, 0x01, 0x04,
+  0x00, 0x80, 0x03, 0x00, 0x80, 0x02, 0x05, 0x80, 0x04, 0x06, 0x80, 0x01, 0x07, 0x80, 0x04, 0x03,
+  0x81, 0x02, 0x02, 0x02, 0x80, 0x01, 0x00, 0x80, 0x03, 0x00, 0x80, 0x02, 0x01, 0x81, 0x02, 0x02,
+  0x04, 0x00, 0x80, 0x02, 0x00, 0x45, 0x00, 0x81, 0x01, 0x03, 0x06, 0x80, 0x02, 0x00, 0x80, 0x01,
+  0x05, 0x80, 0x03, 0x03, 0x81, 0x03, 0x03, 0x02, 0x80, 0x02, 0x00, 0x80, 0x04, 0x00, 0x81, 0x00,
+  0x01, 0x00, 0x81, 0x03, 0x03, 0x04, 0x00, 0x47, 0x00, 0x81, 0x02, 0x02, 0x06, 0x80, 0x03, 0x00,
+  0x80, 0x02, 0x05, 0x81, 0x02, 0x01, 0x02, 0x81, 0x04, 0x04, 0x00, 0x80, 0x01, 0x00, 0x80, 0x03,
+  0x00, 0x80, 0x03, 0x01, 0x80, 0x02, 0x00, 0x81, 0x04, 0x04, 0x04, 0x00, 0x07, 0x82, 0x03, 0x00,
+  0x01, 0x05, 0x80, 0x04, 0x00, 0x80, 0x03, 0x04, 0x82, 0x01, 0x00, 0x02, 0x02, 0x81, 0x03, 0x03,
+  0x00, 0x80, 0x02, 0x00, 0x80, 0x04, 0x00, 0x80, 0x02, 0x01, 0x80, 0x03, 0x00, 0x82, 0x03, 0x03,
+  0x01, 0x03, 0x00, 0x06, 0x81, 0x01, 0x04, 0x00, 0x80, 0x02, 0x01, 0x80, 0x01, 0x02, 0x80, 0x03,
+  0x00, 0x80, 0x04, 0x04, 0x80, 0x02, 0x00, 0x80, 0x03, 0x02, 0x81, 0x02, 0x02, 0x00, 0x80, 0x03,
+  0x00, 0x80, 0x03, 0x00, 0x42, 0x00, 0x80, 0x04, 0x00, 0x42, 0x02, 0x03, 0x00, 0x02, 0x80, 0x01,
+  0x02, 0x81, 0x02, 0x03, 0x00, 0x80, 0x03, 0x01, 0x80, 0x02, 0x02, 0x80, 0x02, 0x00, 0x80, 0x03,
+  0x04, 0x80, 0x03, 0x00, 0x80, 0x04, 0x02, 0x42, 0x00, 0x80, 0x04, 0x00, 0x80, 0x02, 0x03, 0x80,
+  0x03, 0x00, 0x82, 0x00, 0x00, 0x03, 0x03, 0x00, 0x02, 0x80, 0x02, 0x02, 0x81, 0x03, 0x02, 0x00,
+  0x80, 0x04, 0x01, 0x80, 0x03, 0x02, 0x80, 0x00, 0x00, 0x80, 0x02, 0x04, 0x80, 0x04, 0x00, 0x80,
+  0x03, 0x03, 0x80, 0x01, 0x00, 0x80, 0x03, 0x00, 0x44, 0x00, 0x80, 0x02, 0x02, 0x80, 0x04, 0x03,
+  0x00, 0x02, 0x80, 0x03, 0x02, 0x81, 0x04, 0x00, 0x00, 0x80, 0x03, 0x01, 0x80, 0x04, 0x04, 0x45,
+  0x00, 0x80, 0x03, 0x00, 0x80, 0x02, 0x03, 0x80, 0x02, 0x00, 0x80, 0x02, 0x05, 0x81, 0x00, 0x01,
+  0x01, 0x80, 0x03, 0x03, 0x00, 0x02, 0x80, 0x04, 0x02, 0x80, 0x03, 0x01, 0x80, 0x02, 0x01, 0x80,
+  0x03, 0x08, 0x80, 0x01, 0x00, 0x80, 0x02, 0x00, 0x44, 0x00, 0x80, 0x03, 0x00, 0x47, 0x00, 0x80,
+  0x02, 0x01, 0x80, 0x02, 0x03, 0x00, 0x02, 0x80, 0x03, 0x02, 0x80, 0x02, 0x01, 0x42, 0x00, 0x80,
+  0x02, 0x06, 0x80, 0x01, 0x00, 0x80, 0x02, 0x00, 0x46, 0x00, 0x80, 0x04, 0x08, 0x80, 0x03, 0x00,
+  0x82, 0x01, 0x00, 0x01, 0x02, 0x00, 0x02, 0x80, 0x02, 0x02, 0x4D, 0x00, 0x80, 0x02, 0x00, 0x80,
+  0x03, 0x07, 0x80, 0x03, 0x06, 0x80, 0x01, 0x00, 0x80, 0x04, 0x00, 0x80, 0x02, 0x00, 0x80, 0x02,
+  0x02, 0x00, 0x02, 0x42, 0x00, 0x80, 0x01, 0x07, 0x80, 0x01, 0x04, 0x80, 0x03, 0x00, 0x80, 0x04,
+  0x07, 0x80, 0x02, 0x06, 0x80, 0x02, 0x00, 0x80, 0x03, 0x00, 0x80, 0x03, 0x00, 0x80, 0x03, 0x02,
+  0x00, 0x05, 0x80, 0x02, 0x00, 0x80, 0x01, 0x05, 0x80, 0x02, 0x04, 0x80, 0x04, 0x00, 0x80, 0x03,
+  0x05, 0x80, 0x01, 0x00, 0x47, 0x00, 0x80, 0x03, 0x00, 0x80, 0x02, 0x00, 0x80, 0x04, 0x00, 0x80,
+  0x04, 0x02, 0x00, 0x01, 0x80, 0x01, 0x02, 0x80, 0x03, 0x00, 0x80, 0x02, 0x00, 0x80, 0x01, 0x03,
+  0x80, 0x03, 0x04, 0x80, 0x03, 0x00, 0x82, 0x02, 0x01, 0x01, 0x03, 0x80, 0x02, 0x01, 0x80, 0x01,
+  0x05, 0x80, 0x04, 0x00, 0x80, 0x00, 0x00, 0x80, 0x03, 0x00, 0x80, 0x03, 0x02, 0x00, 0x01, 0x80,
+  0x02, 0x02, 0x84, 0x04, 0x01, 0x03, 0x01, 0x02, 0x03, 0x80, 0x04, 0x04, 0x80, 0x02, 0x00, 0x82,
+  0x00, 0x02, 0x02, 0x03, 0x80, 0x03, 0x01, 0x80, 0x02, 0x05, 0x80, 0x03, 0x02, 0x80, 0x02, 0x00,
+  0x80, 0x02, 0x02, 0x00, 0x01, 0x80, 0x03, 0x02, 0x84, 0x03, 0x02, 0x04, 0x02, 0x03, 0x03, 0x80,
+  0x03, 0x04, 0x81, 0x00, 0x01, 0x00, 0x81, 0x03, 0x03, 0x03, 0x80, 0x04, 0x01, 0x80, 0x03, 0x05,
+  0x80, 0x02, 0x02, 0x45, 0x00, 0x00, 0x01, 0x80, 0x04, 0x02, 0x80, 0x02, 0x42, 0x03, 0x80, 0x04,
+  0x03, 0x80, 0x02, 0x05, 0x80, 0x02, 0x00, 0x81, 0x04, 0x04, 0x03, 0x80, 0x03, 0x01, 0x80, 0x04,
+  0x05, 0x49, 0x00, 0x00, 0x01, 0x80, 0x03, 0x00, 0x86, 0x01, 0x01, 0x00, 0x04, 0x02, 0x04, 0x03,
+  0x03, 0x46, 0x00, 0x80, 0x03, 0x00, 0x81, 0x03, 0x03, 0x00, 0x80, 0x01, 0x01, 0x80, 0x02, 0x01,
+  0x80, 0x03, 0x0F, 0x00, 0x01, 0x80, 0x02, 0x00, 0x81, 0x02, 0x02, 0x00, 0x83, 0x03, 0x00, 0x03,
+  0x02, 0x00, 0x80, 0x01, 0x08, 0x80, 0x04, 0x00, 0x81, 0x02, 0x02, 0x00, 0x80, 0x02, 0x01, 0x42,
+  0x00, 0x80, 0x02, 0x0B, 0x80, 0x01, 0x01, 0x80, 0x01, 0x00, 0x01, 0x80, 0x00, 0x00, 0x81, 0x03,
+  0x03, 0x00, 0x80, 0x02, 0x00, 0x81, 0x02, 0x00, 0x00, 0x80, 0x02, 0x08, 0x80, 0x03, 0x00, 0x42,
+  0x00, 0x80, 0x03, 0x04, 0x4C, 0x00, 0x80, 0x02, 0x01, 0x80, 0x02, 0x00, 0x03, 0x81, 0x04, 0x04,
+  0x00, 0x44, 0x00, 0x80, 0x03, 0x08, 0x80, 0x02, 0x00, 0x80, 0x01, 0x01, 0x80, 0x04, 0x00, 0x80,
+  0x01, 0x0F, 0x80, 0x03, 0x01, 0x80, 0x03, 0x00, 0x03, 0x81, 0x03, 0x03, 0x05, 0x80, 0x04, 0x04,
+  0x80, 0x01, 0x02, 0x80, 0x00, 0x00, 0x80, 0x02, 0x01, 0x80, 0x03, 0x00, 0x80, 0x02, 0x02, 0x80,
+  0x01, 0x0B, 0x80, 0x04, 0x01, 0x80, 0x04, 0x00, 0x03, 0x82, 0x02, 0x02, 0x01, 0x04, 0x80, 0x03,
+  0x00, 0x80, 0x01, 0x02, 0x81, 0x02, 0x01, 0x03, 0x80, 0x03, 0x01, 0x80, 0x02, 0x00, 0x80, 0x03,
+  0x02, 0x80, 0x02, 0x0B, 0x80, 0x03, 0x01, 0x80, 0x03, 0x00, 0x03, 0x82, 0x00, 0x00, 0x02, 0x04,
+  0x80, 0x02, 0x00, 0x80, 0x02, 0x02, 0x81, 0x03, 0x02, 0x03, 0x80, 0x04, 0x01, 0x80, 0x00, 0x00,
+  0x80, 0x04, 0x02, 0x80, 0x03, 0x03, 0x80, 0x01, 0x06, 0x80, 0x02, 0x00, 0x81, 0x01, 0x02, 0x00,
+  0x05, 0x80, 0x03, 0x04, 0x80, 0x00, 0x00, 0x80, 0x03, 0x02, 0x81, 0x04, 0x03, 0x03, 0x80, 0x03,
+  0x03, 0x80, 0x03, 0x02, 0x80, 0x04, 0x03, 0x80, 0x02, 0x06, 0x80, 0x00, 0x00, 0x81, 0x02, 0x00,
+  0x00, 0x05, 0x80, 0x04, 0x01, 0x80, 0x01, 0x03, 0x80, 0x04, 0x02, 0x81, 0x03, 0x04, 0x03, 0x80,
+  0x02, 0x03, 0x80, 0x02, 0x02, 0x80, 0x03, 0x03, 0x80, 0x03, 0x08, 0x80, 0x03, 0x00, 0x00, 0x05,
+  0x81, 0x03, 0x01, 0x00, 0x80, 0x02, 0x03, 0x80, 0x03, 0x02, 0x81, 0x02, 0x03, 0x03, 0x48, 0x00,
+  0x80, 0x02, 0x03, 0x80, 0x04, 0x08, 0x80, 0x04, 0x00, 0x00, 0x02, 0x80, 0x01, 0x01, 0x81, 0x02,
+  0x02, 0x00, 0x80, 0x03, 0x03, 0x80, 0x02, 0x02, 0x81, 0x00, 0x02, 0x0C, 0x44, 0x00, 0x80, 0x03,
+  0x08, 0x80, 0x03, 0x00, 0x00, 0x02, 0x80, 0x02, 0x01, 0x81, 0x00, 0x03, 0x00, 0x80, 0x04, 0x03,
+  0x4D, 0x00, 0x80, 0x01, 0x08, 0x80, 0x02, 0x08, 0x80, 0x02, 0x00, 0x00, 0x02, 0x80, 0x03, 0x01,
+  0x81, 0x01, 0x04, 0x00, 0x80, 0x03, 0x11, 0x80, 0x02, 0x08, 0x4B, 0x00, 0x00, 0x02, 0x80, 0x04,
+  0x01, 0x81, 0x02, 0x03, 0x00, 0x80, 0x02, 0x11, 0x80, 0x03, 0x14, 0x00, 0x02, 0x80, 0x03, 0x01,
+  0x81, 0x03, 0x02, 0x00, 0x52, 0x00, 0x80, 0x04, 0x14, 0x00, 0x02, 0x80, 0x02, 0x01, 0x80, 0x04,
+  0x54, 0x00, 0x80, 0x03, 0x14, 0x00, 0x02, 0x42, 0x00, 0x80, 0x03, 0x14, 0x80, 0x02, 0x14, 0x00,
+  0x05, 0x80, 0x02, 0x14, 0x55, 0x00, 0x00, 0x05, 0x6B, 0x00, 0x00, 0x31,
+};
+
+#endif /* ANIM_DATA_H_ */
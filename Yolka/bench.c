@@ -0,0 +1,230 @@
+﻿/*
+ * bench.c
+ *
+ * Замеры производительности на устройстве, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "bench.h"
+#include "wifiman.h"
+#include "effects.h"
+#include "vm.h"
+#include "Yolka.h"
+#include "tools.h"
+#include "fastrnd.h"
+#include "noise.h"
+#include "palette.h"
+#include "zones.h"
+#include "ws2812.h"
+
+// 20 операций на светодиод: только накладные расходы на выборку и переход
+static const PROGMEM uint8_t bench_vm_dispatch_code[] = {
+  VM_LDI, VM_DROP, VM_LDI, VM_DROP, VM_LDI, VM_DROP, VM_LDI, VM_DROP, VM_LDI, VM_DROP, 
+  VM_LDI, VM_DROP, VM_LDI, VM_DROP, VM_LDI, VM_DROP, VM_LDI, VM_DROP, VM_LDI, VM_DROP, 
+  VM_END
+};
+
+// 22 операции на светодиод: радуга с бегущей волной яркости
+static const PROGMEM uint8_t bench_vm_rainbow_code[] = {
+  VM_LDI, VM_PUSH8, 5, VM_MUL, VM_LDT, VM_PUSH8, 3, VM_MUL, VM_ADD,
+  VM_LDI, VM_PUSH16, 0x00, 0x04, VM_MUL, VM_LDT, VM_PUSH16, 0x00, 0x02, VM_MUL, VM_ADD, VM_SIN,
+  VM_PUSH8, 127, VM_MULF, VM_PUSH8, 128, VM_ADD, VM_CLAMP, VM_HB,
+  VM_END
+};
+
+static void bench_vm(PGM_VOID_P pgm_code, uint8_t len, uint16_t count) {
+  uint8_t code[VM_CODE_SIZE + 2];
+  VmContext ctx;
+  memcpy_P(code, pgm_code, len);
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  ctx.t = 0;
+  ctx.n = count;
+  vm_exec(code, &ctx, count, &mem.leds[0]);
+}
+
+static void bench_vm_dispatch(uint16_t count) {
+  bench_vm(bench_vm_dispatch_code, sizeof(bench_vm_dispatch_code), count);
+}
+
+static void bench_vm_rainbow(uint16_t count) {
+  bench_vm(bench_vm_rainbow_code, sizeof(bench_vm_rainbow_code), count);
+}
+
+// Результат генераторов складывается сюда, чтобы компилятор не выбросил вызовы
+static volatile uint16_t bench_sink;
+
+static void bench_random16(uint16_t count) {
+  uint16_t s = 0;
+  while (count--) s += random16();
+  bench_sink = s;
+}
+
+static void bench_randomw(uint16_t count) {
+  uint16_t s = 0;
+  while (count--) s += randomw(150);
+  bench_sink = s;
+}
+
+static void bench_xrnd16(uint16_t count) {
+  uint16_t s = 0;
+  while (count--) s += xrnd16();
+  bench_sink = s;
+}
+
+static void bench_xrnd16_below(uint16_t count) {
+  uint16_t s = 0;
+  while (count--) s += xrnd16_below(150);
+  bench_sink = s;
+}
+
+static void bench_xrnd8(uint16_t count) {
+  uint16_t s = 0;
+  while (count--) s += xrnd8();
+  bench_sink = s;
+}
+
+static void bench_xrnd8_below(uint16_t count) {
+  uint16_t s = 0;
+  while (count--) s += xrnd8_below(150);
+  bench_sink = s;
+}
+
+static void bench_xrnd_fill(uint16_t count) {
+  if (count > sizeof(mem)) count = sizeof(mem);
+  xrnd_fill(&mem, count);
+}
+
+static void bench_noise(uint16_t count, uint8_t octaves) {
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  noise_run(&mem.leds[0].r, 3, count, 0x1234, 0x40, 0x5678, octaves);
+}
+
+static void bench_noise_1(uint16_t count) {
+  bench_noise(count, 1);
+}
+
+static void bench_noise_3(uint16_t count) {
+  bench_noise(count, 3);
+}
+
+static void bench_noise_point(uint16_t count) {
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  uint16_t s = 0;
+  for (uint16_t i = 0; i < count; i++) s += noise8_2d_oct(i << 6, 0x5678, 3);
+  bench_sink = s;
+}
+
+static void bench_hb(uint16_t count) {
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  led_rec * led = mem.leds;
+  for (uint16_t i = 0; i < count; i++) hb(i, 255, led++);
+}
+
+static void bench_hb_uncached(uint16_t count) {
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  led_rec * led = mem.leds;
+  for (uint16_t i = 0; i < count; i++) hb(i, 254, led++);
+}
+
+static void bench_palette_fill(uint16_t count) {
+  uint8_t pal[PALETTE_RAM_SIZE];
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  palette_load(0, pal);
+  palette_fill(pal, mem.leds, count, 0, 0x100);
+}
+
+static void bench_palette_map(uint16_t count) {
+  uint8_t pal[PALETTE_RAM_SIZE];
+  if (count > MAX_LED_COUNT) count = MAX_LED_COUNT;
+  palette_load(0, pal);
+  palette_map(pal, mem.leds, count);
+}
+
+static const PROGMEM uint8_t str_bench_vm_dispatch[] = "VM dispatch, 20 ops x count LEDs";
+static const PROGMEM uint8_t str_bench_vm_rainbow[] = "VM rainbow, 22 ops x count LEDs";
+static const PROGMEM uint8_t str_bench_random16[] = "random16() x count";
+static const PROGMEM uint8_t str_bench_randomw[] = "randomw(150) x count";
+static const PROGMEM uint8_t str_bench_xrnd16[] = "xrnd16() x count";
+static const PROGMEM uint8_t str_bench_xrnd16_below[] = "xrnd16_below(150) x count";
+static const PROGMEM uint8_t str_bench_xrnd8[] = "xrnd8() x count";
+static const PROGMEM uint8_t str_bench_xrnd8_below[] = "xrnd8_below(150) x count";
+static const PROGMEM uint8_t str_bench_xrnd_fill[] = "xrnd_fill, count bytes";
+static const PROGMEM uint8_t str_bench_noise_1[] = "noise_run 1 octave, count LEDs";
+static const PROGMEM uint8_t str_bench_noise_3[] = "noise_run 3 octaves, count LEDs";
+static const PROGMEM uint8_t str_bench_noise_point[] = "noise8_2d_oct 3 octaves x count";
+static const PROGMEM uint8_t str_bench_hb[] = "hb(h, 255) x count LEDs, table if cached";
+static const PROGMEM uint8_t str_bench_hb_uncached[] = "hb(h, 254) x count LEDs, computed";
+static const PROGMEM uint8_t str_bench_palette_fill[] = "palette_fill, count LEDs";
+static const PROGMEM uint8_t str_bench_palette_map[] = "palette_map, count LEDs";
+
+PROGMEM const BenchDesc bench_list[] = {
+  {str_bench_vm_dispatch, bench_vm_dispatch},
+  {str_bench_vm_rainbow, bench_vm_rainbow},
+  {str_bench_random16, bench_random16},
+  {str_bench_randomw, bench_randomw},
+  {str_bench_xrnd16, bench_xrnd16},
+  {str_bench_xrnd16_below, bench_xrnd16_below},
+  {str_bench_xrnd8, bench_xrnd8},
+  {str_bench_xrnd8_below, bench_xrnd8_below},
+  {str_bench_xrnd_fill, bench_xrnd_fill},
+  {str_bench_noise_1, bench_noise_1},
+  {str_bench_noise_3, bench_noise_3},
+  {str_bench_noise_point, bench_noise_point},
+  {str_bench_hb, bench_hb},
+  {str_bench_hb_uncached, bench_hb_uncached},
+  {str_bench_palette_fill, bench_palette_fill},
+  {str_bench_palette_map, bench_palette_map},
+};
+
+const uint8_t num_benches = arraysize(bench_list);
+
+uint32_t bench_run(uint8_t n, uint16_t count) {
+  void (*run)(uint16_t) = pgm_read_ptr(&bench_list[n].run);
+  wifiman_wait_outbuf();
+  // На время замера приостанавливаем приём, чтобы прерывания не вносили погрешность
+  uint8_t sup = wifiman_suspend_cts();
+  uint32_t start = wifiman_time_long();
+  run(count);
+  uint32_t spent = wifiman_time_long() - start;
+  wifiman_restore_cts(sup);
+  if (spent > BENCH_TIME_LIMIT) return BENCH_OVERTIME;
+  return spent * TIMER_TICK_CYCLES;
+}
+
+uint32_t bench_effect(uint8_t ef, uint8_t frames, uint8_t output, uint32_t limit, BenchEffectResult * res) {
+  uint16_t rmin = 0xFFFF, rmax = 0, omax = 0;
+  uint32_t rsum = 0, osum = 0;
+  uint8_t done = 0;
+  wifiman_wait_outbuf();
+  zones_single(ef);
+  if (!frames) frames = 1;
+  while ((done < frames) && ((rsum + osum) < limit)) {
+    // Приём приостанавливается только на время замеров, чтобы между кадрами входящие данные успевали разбираться в очередь
+    uint8_t sup = wifiman_suspend_cts();
+    uint16_t t = wifiman_time();
+    zones_render();
+    t = wifiman_time() - t;
+    if (t < rmin) rmin = t;
+    if (t > rmax) rmax = t;
+    rsum += t;
+    if (output) {
+      t = wifiman_time();
+      led_data_out(mem.leds, led_num);
+      t = wifiman_time() - t;
+      if (t > omax) omax = t;
+      osum += t;
+    }
+    wifiman_restore_cts(sup);
+    done++;
+  }
+  res->frames = done;
+  res->render_min = rmin;
+  res->render_avg = rsum / done;
+  res->render_max = rmax;
+  res->out_avg = osum / done;
+  res->out_max = omax;
+  return rsum + osum;
+}
@@ -0,0 +1,52 @@
+﻿/*
+ * bench.h
+ *
+ * Замеры производительности на устройстве, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <avr/pgmspace.h>
+
+typedef struct {
+  PGM_VOID_P name;
+  void (*run)(uint16_t count); // Выполняет count итераций замеряемой операции (смысл count описан в названии теста)
+} BenchDesc;
+
+extern const PROGMEM BenchDesc bench_list[];
+extern const uint8_t num_benches;
+
+// Наибольшее время одного замера, в тактах таймера 1 (одна секунда)
+#define BENCH_TIME_LIMIT (TIMER_TICKS_PER_FRAME * 50UL)
+
+// Наибольшее время замера эффектов одной командой, в тактах таймера 1
+#define BENCH_EFFECT_TIME_LIMIT BENCH_TIME_LIMIT
+
+// Результат bench_run, если тест выполнялся дольше BENCH_TIME_LIMIT
+#define BENCH_OVERTIME 0xFFFFFFFFUL
+
+/* Выполняет тест номер n с параметром count. Возвращает затраченное время в тактах процессора (с точностью до TIMER_TICK_CYCLES)
+ * или BENCH_OVERTIME, если тест занял больше BENCH_TIME_LIMIT: тогда count следует уменьшить. Содержимое mem.leds может быть испорчено */
+uint32_t bench_run(uint8_t n, uint16_t count);
+
+// Результат замера эффекта (bench_effect), в тактах таймера 1 (по TIMER_TICK_CYCLES тактов процессора)
+typedef struct {
+  uint8_t frames; // Сколько кадров отрисовано (меньше запрошенного, если вышло время)
+  uint16_t render_min; // Отрисовка кадра: минимум,
+  uint16_t render_avg; // среднее
+  uint16_t render_max; // и максимум
+  uint16_t out_avg; // Вывод на ленту: среднее
+  uint16_t out_max; // и максимум (0, если вывод не выполнялся)
+} BenchEffectResult;
+
+/* Отрисовывает эффект ef на всей ленте frames кадров подряд, без ожидания начала кадра, выводя каждый кадр на ленту, если output не ноль.
+ * Замер прекращается раньше, когда затраченное время достигает limit тактов таймера (но хотя бы один кадр отрисовывается).
+ * Возвращает затраченное время в тактах таймера. Такты таймера за это время не обрабатываются, поэтому limit не должен превышать
+ * BENCH_EFFECT_TIME_LIMIT. Описание зон и содержимое mem.leds при этом теряются: после замера нужно вызвать zones_invalidate */
+uint32_t bench_effect(uint8_t ef, uint8_t frames, uint8_t output, uint32_t limit, BenchEffectResult * res);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,29 @@
+﻿/*
+ * cache.c
+ *
+ * Таблицы для ускорения расчётов в свободной части буфера ленты, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include "cache.h"
+#include "effects.h"
+
+led_rec * cache_hue;
+
+void cache_setup(uint8_t * from, uint8_t * to) {
+  cache_release();
+  if ((uint16_t)(to - from) >= CACHE_HUE_SIZE) {
+    led_rec * t = (led_rec *)from;
+    uint8_t h = 0;
+    do {
+      hb(h, 255, &t[h]);
+    } while (++h);
+    cache_hue = t;
+  }
+}
+
+void cache_release() {
+  cache_hue = 0;
+}
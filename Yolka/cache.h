@@ -0,0 +1,33 @@
+﻿/*
+ * cache.h
+ *
+ * Таблицы для ускорения расчётов в свободной части буфера ленты, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <avr/io.h>
+#include "ws2812.h"
+
+/* Буфер mem рассчитан на MAX_LED_COUNT светодиодов, а обычно их гораздо меньше. Промежуток между данными светодиодов
+ * и состояниями зон (см. zones.c) занимается таблицами, если они туда помещаются. Каждая таблица может отсутствовать,
+ * поэтому пользующийся ею код должен проверять указатель и иметь запасной путь с тем же результатом.
+ * Содержимое таблиц пересчитывается при каждой загрузке зон и теряется при zones_invalidate().
+ */
+
+#define CACHE_HUE_SIZE (256 * sizeof(led_rec))
+
+// hb(h, 255) для всех h, либо 0, если таблицы нет
+extern led_rec * cache_hue;
+
+/* Размещает таблицы в области памяти от from до to и заполняет их */
+void cache_setup(uint8_t * from, uint8_t * to);
+
+/* Отказывается от таблиц: область памяти под ними будет использована для чего-то другого */
+void cache_release();
+
+#endif /* CACHE_H_ */
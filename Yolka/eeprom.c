@@ -9,6 +9,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "eeprom.h"
+#include "trace.h"
 
 
 uint8_t eeprom_read(uint16_t address, uint8_t return_if_0xFF) {
@@ -32,6 +33,7 @@ void eeprom_write(uint16_t address, uint8_t data) {
   EECR |= (1<<EERE);  
   uint8_t d = EEDR;
   if (d != data) {
+    TRACE(TRACE_EEPROM, address);
     EEDR = data;
     EECR |= (1<<EEMPE);
     EECR |= (1<<EEPE);
@@ -10,6 +10,13 @@
 #include <avr/pgmspace.h>
 #include "effects.h"
 #include "Yolka.h"
+#include "anim.h"
+#include "vm.h"
+#include "geometry.h"
+#include "fastrnd.h"
+#include "noise.h"
+#include "palette.h"
+#include "cache.h"
 
 MemoryBlock mem;
 
@@ -38,7 +45,7 @@ const static PROGMEM uint16_t sin_table[] = {
  соответствует полному периоду синуса. Результат домножается на заданный множитель.
  эквивалентно round(sin(2.0 * M_PI * (period / 65536)) * scaler)
  */
-static int16_t sin_t(uint16_t period, int16_t scaler) {
+int16_t sin_t(uint16_t period, int16_t scaler) {
   uint16_t tabpos = (period >> 6) & 511;
   uint8_t tabsub = period & 63;
   if (tabpos == 256) return (period & 0x8000) ? -scaler : scaler;
@@ -70,6 +77,10 @@ static int16_t sin_t(uint16_t period, int16_t scaler) {
   b - яроксть, от 0 (чёрный) до 255 (полная яркость)
 */
 void hb(uint8_t h, uint8_t b, led_rec * led) {
+  if ((b == 255) && cache_hue) {
+    *led = cache_hue[h];
+    return;
+  }
   uint16_t th = h * 6;
   uint8_t a = ((uint8_t)th * b + 128) >> 8;
   switch (th >> 8) {
@@ -91,6 +102,10 @@ void hb(uint8_t h, uint8_t b, led_rec * led) {
   b - яроксть, от 0 (чёрный) до 255 (полная яркость)
 */
 void hsb(uint8_t h, uint8_t s, uint8_t b, led_rec * led) {
+  if (((s & b) == 255) && cache_hue) { // Полная насыщенность и яркость - то же, что hb(h, 255)
+    *led = cache_hue[h];
+    return;
+  }
   uint16_t th = h * 6;
   uint8_t z = ((255 - s) * b + 128) >> 8; // Нулевая точка
   uint8_t ab = b - z;
@@ -128,8 +143,8 @@ void hbover(uint8_t h, uint16_t b, led_rec * led) {
 }
 
 
-void blur() {
-  led_rec * led = &mem.leds[0];
+void blur(led_rec * led, uint16_t count) {
+  if (count < 2) return;
   uint8_t pr = led->r;
   uint8_t pg = led->g;
   uint8_t pb = led->b;
@@ -137,7 +152,7 @@ void blur() {
   led->g = (pg * 7 + led[1].g) >> 3;
   led->b = (pb * 7 + led[1].b) >> 3;
   led++;
-  for (uint16_t i = 2; i < led_num; i++) {
+  for (uint16_t i = 2; i < count; i++) {
     uint8_t nr = led->r;
     uint8_t ng = led->g;
     uint8_t nb = led->b;
@@ -154,8 +169,8 @@ void blur() {
   led->b = (pb + led->b * 7) >> 3;
 }
 
-void blur2(uint8_t fade) {
-  led_rec * led = &mem.leds[0];
+void blur2(led_rec * led, uint16_t count, uint8_t fade) {
+  if (count < 2) return;
   uint8_t pr = led->r;
   uint8_t pg = led->g;
   uint8_t pb = led->b;
@@ -167,7 +182,7 @@ void blur2(uint8_t fade) {
   t = (pb + led[1].b) >> 1;
   led->b = (t < fade) ? 0 : (t - fade);
   led++;
-  for (uint16_t i = 2; i < led_num; i++) {
+  for (uint16_t i = 2; i < count; i++) {
     uint8_t nr = led->r;
     uint8_t ng = led->g;
     uint8_t nb = led->b;
@@ -190,9 +205,9 @@ void blur2(uint8_t fade) {
   led->b = (t < fade) ? 0 : (t - fade);
 }
 
-void clear() {
-  uint8_t * ptr = (uint8_t*)&mem.leds[0];
-  for (uint16_t i = led_num * 3; i; i--) {
+void clear(led_rec * led, uint16_t count) {
+  uint8_t * ptr = (uint8_t*)led;
+  for (uint16_t i = count * 3; i; i--) {
     *(ptr++) = 0;
   }
 }  
@@ -202,260 +217,462 @@ void clear() {
 /* ЭФФЕКТЫ */
 /***********/  
 
-void wave() {
-  uint16_t p = random16();
-  uint8_t fp = 0;
-  do {
-    uint8_t ip = p >> 8;
-    for (uint16_t i = 0; i < led_num; i++) {
-      uint8_t pha = (i < fp) ? (i + 150 - fp) : (i - fp);
-      while (pha >= 150) pha -= 150;
-      if (pha < 25) pha = 0; else pha -= 25;
-      hbover(ip, pha * 3, &mem.leds[i]);
-//      hbover(p, i * 10, &mem.leds[i]);
-      ip += 7;
-    }
-    p += 61;
-    fp++;
-    if (fp >= 150) fp = 0;
-  } while (sync_out(&mem.leds));
+/* Каждый эффект за один вызов отрисовывает один кадр в своей зоне. 
+ * Всё, что должно сохраняться между кадрами, хранится в состоянии зоны (z->st), а не в локальных переменных */
+
+typedef struct {
+  uint16_t p;
+  uint8_t fp;
+} WaveState;
+EFFECT_STATE_CHECK(WaveState);
+
+void wave(EffectZone * z) {
+  WaveState * s = EFFECT_STATE(z, WaveState);
+  if (z->init) {
+    s->p = random16();
+    s->fp = 0;
+  }
+  uint8_t fp = s->fp;
+  uint8_t ip = s->p >> 8;
+  for (led_idx_t i = 0; i < ZONE_NUM(z); i++) {
+    uint8_t pha = (i < fp) ? (i + 150 - fp) : (i - fp);
+    while (pha >= 150) pha -= 150;
+    if (pha < 25) pha = 0; else pha -= 25;
+    hbover(ip, pha * 3, &z->leds[i]);
+    ip += 7;
+  }
+  s->p += 61;
+  fp++;
+  if (fp >= 150) fp = 0;
+  s->fp = fp;
 }
 
-void sparkles() {
-  uint16_t time_to_sparkle = 0;
-  do {
-    led_rec * led = &mem.leds[0];
-    for (uint16_t i = 0; i < led_num; i++) {
-/*      led->r >>= 1;
-      led->g >>= 1;
-      led->b >>= 1;*/
-      led->r = 0;
-      led->g = 0;
-      led->b = 0;
-      led++;
-    }
-    while (time_to_sparkle <= led_num) {
-      led = &mem.leds[randomw(led_num)];
-      led->r = 255 - (random8() >> 3);
-      led->g = 255 - (random8() >> 3);
-      led->b = 255 - (random8() >> 3);
-      time_to_sparkle += randomw(250);
-    }
-    time_to_sparkle -= led_num;
-  } while (sync_out(&mem.leds));
+typedef struct {
+  uint16_t time_to_sparkle;
+} SparklesState;
+EFFECT_STATE_CHECK(SparklesState);
+
+void sparkles(EffectZone * z) {
+  SparklesState * s = EFFECT_STATE(z, SparklesState);
+  if (z->init) {
+    s->time_to_sparkle = 0;
+  }
+  uint16_t time_to_sparkle = s->time_to_sparkle;
+  clear(z->leds, ZONE_NUM(z));
+  while (time_to_sparkle <= ZONE_NUM(z)) {
+    led_rec * led = &z->leds[xrnd16_below(ZONE_NUM(z))];
+    led->r = 255 - (xrnd8() >> 3);
+    led->g = 255 - (xrnd8() >> 3);
+    led->b = 255 - (xrnd8() >> 3);
+    time_to_sparkle += xrnd8_below(250);
+  }
+  s->time_to_sparkle = time_to_sparkle - ZONE_NUM(z);
 }
 
-void rain() {
-  uint8_t h = 0;
-  uint16_t b = 0;
-  uint8_t c = 0;
-  do {
-    led_rec * led = &mem.leds[0];
-    for (uint16_t i = 1; i < led_num; i++) {
-      led->r = led[1].r;
-      led->g = led[1].g;
-      led->b = led[1].b;
-      led++;
-    }
-    if (!c) {
-      h = random8();
-      b = 500;
-      c = random(35) + 3;
-    } else {
-      b = (b * 3) >> 2;
-      h += 7;
-      c--;
-    }
-    hbover(h, b, led);
-  } while (sync_out(&mem.leds));
+typedef struct {
+  uint16_t b;
+  uint8_t h;
+  uint8_t c;
+} RainState;
+EFFECT_STATE_CHECK(RainState);
+
+void rain(EffectZone * z) {
+  RainState * s = EFFECT_STATE(z, RainState);
+  if (z->init) {
+    s->h = 0;
+    s->b = 0;
+    s->c = 0;
+  }
+  led_rec * led = z->leds;
+  for (led_idx_t i = 1; i < ZONE_NUM(z); i++) {
+    led->r = led[1].r;
+    led->g = led[1].g;
+    led->b = led[1].b;
+    led++;
+  }
+  if (!s->c) {
+    s->h = random8();
+    s->b = 500;
+    s->c = random(35) + 3;
+  } else {
+    s->b = (s->b * 3) >> 2;
+    s->h += 7;
+    s->c--;
+  }
+  hbover(s->h, s->b, led);
 }
 
-void drops() {
-  clear();
-  uint16_t time_to_drop = 0;
-  do {
-    blur();
-    while (time_to_drop <= led_num) {
-      hb(random8(), 255, &mem.leds[randomw(led_num)]);
-      time_to_drop += randomw(700);
-    }
-    time_to_drop -= led_num;
-  } while (sync_out(&mem.leds));
+typedef struct {
+  uint16_t time_to_drop;
+} DropsState;
+EFFECT_STATE_CHECK(DropsState);
+
+void drops(EffectZone * z) {
+  DropsState * s = EFFECT_STATE(z, DropsState);
+  if (z->init) {
+    clear(z->leds, ZONE_NUM(z));
+    s->time_to_drop = 0;
+  }
+  uint16_t time_to_drop = s->time_to_drop;
+  blur(z->leds, ZONE_NUM(z));
+  while (time_to_drop <= ZONE_NUM(z)) {
+    hb(xrnd8(), 255, &z->leds[xrnd16_below(ZONE_NUM(z))]);
+    time_to_drop += xrnd16_below(700);
+  }
+  s->time_to_drop = time_to_drop - ZONE_NUM(z);
 }
 
-void twist() {
-  uint16_t alpha = random16();
-  uint16_t p = random16();
-  uint16_t hstepmulfor = 0;
-  uint16_t hstepmul = 0;
-  do {
-    uint16_t h = p;
-    if (hstepmulfor != led_num) {
-      hstepmul = 50000 / (led_num >> 3);
-      hstepmulfor = led_num;
-    }
-    uint16_t hstep = sin_t(alpha, hstepmul);
-    for (uint16_t i = led_num; i; i--) {
-      hb(h >> 8, 255, &mem.leds[i - 1]);
-//      hbover(p, i * 10, &mem.leds[i]);
-      h += hstep;
-    }
-    p += 97;
-    alpha += 61;
-  } while (sync_out(&mem.leds));
+typedef struct {
+  uint16_t alpha;
+  uint16_t p;
+  uint16_t hstepmul;
+} TwistState;
+EFFECT_STATE_CHECK(TwistState);
+
+void twist(EffectZone * z) {
+  TwistState * s = EFFECT_STATE(z, TwistState);
+  if (z->init) {
+    s->alpha = random16();
+    s->p = random16();
+    s->hstepmul = (ZONE_NUM(z) >= 8) ? (50000 / (ZONE_NUM(z) >> 3)) : 50000;
+  }
+  uint16_t h = s->p;
+  uint16_t hstep = sin_t(s->alpha, s->hstepmul);
+  for (led_idx_t i = ZONE_NUM(z); i; i--) {
+    hb(h >> 8, 255, &z->leds[i - 1]);
+    h += hstep;
+  }
+  s->p += 97;
+  s->alpha += 61;
 }
 
-void meteors() {
-  typedef struct {
-    int16_t phase;
-    int16_t start;
-    int8_t direction;
-    uint16_t phase_dec;
-    uint16_t first_color;
-    uint16_t size;
-    uint16_t color_twist;
-  } Meteor;
+typedef struct {
+  int16_t phase;
+  int16_t start;
+  int8_t direction;
+  uint16_t phase_dec;
+  uint16_t first_color;
+  uint16_t size;
+  uint16_t color_twist;
+} Meteor;
+
+typedef struct {
   Meteor mets[5];
+  uint8_t time_to_met;
+} MeteorsState;
+EFFECT_STATE_CHECK(MeteorsState);
+
+void meteors(EffectZone * z) {
+  MeteorsState * s = EFFECT_STATE(z, MeteorsState);
+  Meteor * mets = s->mets;
+  uint16_t num = ZONE_NUM(z);
+  led_rec * leds = z->leds;
   led_rec led;
-  uint8_t time_to_met = 0;
-  for (uint8_t i = 0; i < (sizeof(mets) / sizeof(mets[0])); i++) {
-    mets[i].phase = 0;
-  }   
-  do {
-    clear();
-    uint8_t free_met = 255;
-    for (uint8_t i = 0; i < (sizeof(mets) / sizeof(mets[0])); i++) {
-      if (mets[i].phase == 0) {
-        free_met = i;
-      } else {
-        int16_t ln = mets[i].start;
-        int8_t dir = mets[i].direction;
-        uint16_t sz = mets[i].size;
-        int16_t ph = mets[i].phase;
-        uint16_t phdec = mets[i].phase_dec;
-        uint16_t col = mets[i].first_color;
-        uint16_t coltw = mets[i].color_twist;
-        do {
-          if ((ln >= 0) && (ln < led_num)) {
-            int16_t bright = 512 - (ph >> 5);
-            if (bright > 0) {
-              hbover(col >> 8, bright, &led);
-              if (led.r > mem.leds[ln].r) mem.leds[ln].r = led.r;
-              if (led.g > mem.leds[ln].g) mem.leds[ln].g = led.g;
-              if (led.b > mem.leds[ln].b) mem.leds[ln].b = led.b;
-            }
+  if (z->init) {
+    s->time_to_met = 0;
+    for (uint8_t i = 0; i < (sizeof(s->mets) / sizeof(s->mets[0])); i++) {
+      mets[i].phase = 0;
+    }
+  }
+  clear(leds, num);
+  uint8_t free_met = 255;
+  for (uint8_t i = 0; i < (sizeof(s->mets) / sizeof(s->mets[0])); i++) {
+    if (mets[i].phase == 0) {
+      free_met = i;
+    } else {
+      int16_t ln = mets[i].start;
+      int8_t dir = mets[i].direction;
+      uint16_t sz = mets[i].size;
+      int16_t ph = mets[i].phase;
+      uint16_t phdec = mets[i].phase_dec;
+      uint16_t col = mets[i].first_color;
+      uint16_t coltw = mets[i].color_twist;
+      do {
+        if ((ln >= 0) && (ln < num)) {
+          int16_t bright = 512 - (ph >> 5);
+          if (bright > 0) {
+            hbover(col >> 8, bright, &led);
+            if (led.r > leds[ln].r) leds[ln].r = led.r;
+            if (led.g > leds[ln].g) leds[ln].g = led.g;
+            if (led.b > leds[ln].b) leds[ln].b = led.b;
           }
-          col += coltw;
-          ln += dir;
-          sz--;
-          ph -= phdec;
-        } while ((ph > 0) && (sz > 0));
-        if (ph > 16384) {
-          mets[i].phase = 0;
-          free_met = i;
-        } else {
-          mets[i].phase += 256;
         }
+        col += coltw;
+        ln += dir;
+        sz--;
+        ph -= phdec;
+      } while ((ph > 0) && (sz > 0));
+      if (ph > 16384) {
+        mets[i].phase = 0;
+        free_met = i;
+      } else {
+        mets[i].phase += 256;
       }
     }
-    if (time_to_met == 0) {
-      if (free_met < 255) {
-        mets[free_met].phase = 256;
-        mets[free_met].direction = (random8() & 1) ? 1 : -1;
-        uint16_t sz = random(led_num >> 1) + (led_num >> 3) - 1;
-        uint16_t mid = randomw(led_num);
-        uint16_t ed = mid + (sz >> 1);
-        uint16_t st = (ed > sz) ? (ed - sz) : 0;
-        if (ed >= led_num) ed = led_num - 1;
-        
-        mets[free_met].size = ed - st + 1;
-        mets[free_met].start = (mets[free_met].direction < 0) ? ed : st;
-        mets[free_met].phase_dec = (8192 + randomw(16384)) / led_num;
-        mets[free_met].first_color = random16();
-        mets[free_met].color_twist = randomw(16384) + randomw(16384) + randomw(16384) + randomw(16384) - 32768;
-        time_to_met = random(50);
-      }
-    } else {
-      time_to_met--;
+  }
+  if (s->time_to_met == 0) {
+    if (free_met < 255) {
+      mets[free_met].phase = 256;
+      mets[free_met].direction = (xrnd8() & 1) ? 1 : -1;
+      uint16_t sz = xrnd16_below(num >> 1) + (num >> 3) - 1;
+      uint16_t mid = xrnd16_below(num);
+      uint16_t ed = mid + (sz >> 1);
+      uint16_t st = (ed > sz) ? (ed - sz) : 0;
+      if (ed >= num) ed = num - 1;
+      
+      mets[free_met].size = ed - st + 1;
+      mets[free_met].start = (mets[free_met].direction < 0) ? ed : st;
+      mets[free_met].phase_dec = (8192 + xrnd16_below(16384)) / num;
+      mets[free_met].first_color = xrnd16();
+      mets[free_met].color_twist = (xrnd16() >> 2) + (xrnd16() >> 2) + (xrnd16() >> 2) + (xrnd16() >> 2) - 32768;
+      s->time_to_met = xrnd8_below(50);
     }
-  } while (sync_out(&mem.leds));
+  } else {
+    s->time_to_met--;
+  }
 }
 
-void interference() {
-  uint16_t startclr = random16();
-  int16_t stepclr = randomw(8192) + 512;
-  if (random8() & 1) stepclr = -stepclr;
-  int16_t stepstartclr = randomw(256) + 64;
-  if (random8() & 1) stepstartclr = -stepstartclr;
+typedef struct {
+  uint16_t startclr;
+  int16_t stepclr;
+  int16_t stepstartclr;
+  uint16_t ampphase;
+  int16_t ampphstep;
+  uint16_t ampphdira;
+  uint16_t levphase;
+  uint16_t levphasestep;
+} InterferenceState;
+EFFECT_STATE_CHECK(InterferenceState);
+
+void interference(EffectZone * z) {
+  InterferenceState * s = EFFECT_STATE(z, InterferenceState);
+  if (z->init) {
+    s->startclr = random16();
+    s->stepclr = randomw(8192) + 512;
+    if (random8() & 1) s->stepclr = -s->stepclr;
+    s->stepstartclr = randomw(256) + 64;
+    if (random8() & 1) s->stepstartclr = -s->stepstartclr;
+    
+    s->ampphase = random16();
+    s->ampphstep = randomw(8192) + 4096;
+    if (random8() & 1) s->ampphstep = -s->ampphstep;
+    s->ampphdira = random16();
+    
+    s->levphase = random16();
+    s->levphasestep = randomw(256) + 256;
+  }
   
-  uint16_t ampphase = random16();
-  int16_t ampphstep = randomw(8192) + 4096;
-  if (random8() & 1) ampphstep = -ampphstep;
-  uint16_t ampphdira = random16();
+  uint16_t ampph = s->ampphase;
+  s->ampphase += sin_t(s->ampphdira, 2048);
+  s->ampphdira += 79;
   
-  uint16_t levphase = random16();
-  uint16_t levphasestep = randomw(256) + 256;
+  uint16_t level = sin_t(s->levphase, 96) + 160;
+  s->levphase += s->levphasestep;
   
-  do {
-    uint16_t ampph = ampphase;
-    ampphase += sin_t(ampphdira, 2048);
-    ampphdira += 79;
-    
-    uint16_t level = sin_t(levphase, 96) + 160;
-    levphase += levphasestep;
-    
-    
-    uint16_t clr = startclr;
-    startclr += stepstartclr;
-    for(uint16_t i = 0; i < led_num; i++) {
-      hbover(clr >> 8, 256 + sin_t(ampph, level), &mem.leds[i]);
-      clr += stepclr;
-      ampph += ampphstep;
-    }
-  } while (sync_out(&mem.leds));
+  uint16_t clr = s->startclr;
+  s->startclr += s->stepstartclr;
+  int16_t stepclr = s->stepclr;
+  int16_t ampphstep = s->ampphstep;
+  for (led_idx_t i = 0; i < ZONE_NUM(z); i++) {
+    hbover(clr >> 8, 256 + sin_t(ampph, level), &z->leds[i]);
+    clr += stepclr;
+    ampph += ampphstep;
+  }
 }
 
-void metamorphosis() {
-  uint16_t init_seed = 0;
-  uint16_t init_hue = 0;
-  uint16_t p_cur = 65535;
-  uint16_t led_step = 0;
-  uint16_t calced_for_lednum = 65535;
-  int16_t h_twist = 0;
-  do {
-    if (calced_for_lednum != led_num) {
-      led_step = (led_num > 0) ? (1600 / led_num) : 0;
-      calced_for_lednum = led_num;
-    }
-    if (p_cur >= 5000) {
-      p_cur = 0;
-      init_seed = random16();
-      init_hue += randomw(27307) + randomw(27307) + 5461;
-      uint8_t r = random8();
-      if (r >= 192) {
-        h_twist = randomw(4096) + randomw(4096) + randomw(4096) + randomw(4096) - 8192;
-      } else {
-        h_twist = 0;
-      }
+typedef struct {
+  uint16_t init_seed;
+  uint16_t init_hue;
+  uint16_t p_cur;
+  uint16_t led_step;
+  int16_t h_twist;
+} MetamorphosisState;
+EFFECT_STATE_CHECK(MetamorphosisState);
+
+void metamorphosis(EffectZone * z) {
+  MetamorphosisState * s = EFFECT_STATE(z, MetamorphosisState);
+  if (z->init) {
+    s->init_seed = 0;
+    s->init_hue = 0;
+    s->p_cur = 65535;
+    s->led_step = 1600 / ZONE_NUM(z);
+    s->h_twist = 0;
+  }
+  if (s->p_cur >= 5000) {
+    s->p_cur = 0;
+    s->init_seed = xrnd16();
+    s->init_hue += xrnd16_below(27307) + xrnd16_below(27307) + 5461;
+    uint8_t r = xrnd8();
+    if (r >= 192) {
+      s->h_twist = (xrnd16() >> 4) + (xrnd16() >> 4) + (xrnd16() >> 4) + (xrnd16() >> 4) - 8192;
+    } else {
+      s->h_twist = 0;
     }
-    p_cur += 13;
-    uint16_t p = 0;
-    uint16_t rnd = init_seed;
-    uint16_t h = init_hue;
-    for (int16_t i = led_num - 1; i >= 0; i--) {
-      rnd = (uint16_t)(rnd + 1) * 53093U;
-      uint16_t px = p + (rnd >> 8);
-      if (p_cur >= px) {
-        uint16_t d = (p_cur - px);
-        hbover(h >> 8, (d > 384) ? 255 : (640 - d), &mem.leds[i]);
-      }
-      p += led_step;
-      h += h_twist;
+  }
+  s->p_cur += 13;
+  uint16_t p_cur = s->p_cur;
+  uint16_t led_step = s->led_step;
+  int16_t h_twist = s->h_twist;
+  uint16_t p = 0;
+  uint16_t rnd = s->init_seed;
+  uint16_t h = s->init_hue;
+  for (led_idx_t i = ZONE_NUM(z); i--; ) {
+    rnd = (uint16_t)(rnd + 1) * 53093U;
+    uint16_t px = p + (rnd >> 8);
+    if (p_cur >= px) {
+      uint16_t d = (p_cur - px);
+      hbover(h >> 8, (d > 384) ? 255 : (640 - d), &z->leds[i]);
     }
-  } while (sync_out(&mem.leds));
-  
-  
-  
+    p += led_step;
+    h += h_twist;
+  }
+}
+
+/* Пространственные эффекты: цвет светодиода определяется его положением на ёлке (см. geometry.h) */
+
+typedef struct {
+  uint16_t phase;
+  uint16_t hue;
+} SweepState;
+EFFECT_STATE_CHECK(SweepState);
+
+// Светящийся пояс, плавно перемещающийся вверх-вниз по ёлке
+void sweep(EffectZone * z) {
+  SweepState * s = EFFECT_STATE(z, SweepState);
+  if (z->init) {
+    s->phase = random16();
+    s->hue = random16();
+  }
+  int16_t pos = 128 + sin_t(s->phase, 160);
+  uint8_t hue = s->hue >> 8;
+  s->phase += 200;
+  s->hue += 37;
+  GeoCursor c;
+  geo_seek(&c, z->leds - mem.leds);
+  led_rec * led = z->leds;
+  for (led_idx_t i = ZONE_NUM(z); i; i--) {
+    int16_t d = c.h - pos;
+    if (d < 0) d = -d;
+    d = 400 - d * 8;
+    hbover(hue + (c.h >> 2), (d > 0) ? d : 0, led++);
+    geo_next(&c);
+  }
+}
+
+typedef struct {
+  uint16_t t;
+  uint8_t arms;
+  int8_t twist;
+  uint8_t hue;
+} SpiralState;
+EFFECT_STATE_CHECK(SpiralState);
+
+// Спиральные полосы, вращающиеся вокруг ёлки
+void spiral(EffectZone * z) {
+  SpiralState * s = EFFECT_STATE(z, SpiralState);
+  if (z->init) {
+    s->t = 0;
+    s->arms = random(3) + 1;
+    s->twist = random(5) - 2;
+    s->hue = random8();
+  }
+  uint8_t t = s->t >> 2;
+  uint8_t arms = s->arms;
+  int8_t twist = s->twist;
+  uint8_t hue = s->hue;
+  s->t += 7;
+  s->hue++;
+  GeoCursor c;
+  geo_seek(&c, z->leds - mem.leds);
+  led_rec * led = z->leds;
+  for (led_idx_t i = ZONE_NUM(z); i; i--) {
+    uint8_t v = c.a * arms + (int8_t)((c.h * twist) >> 2) - t;
+    uint8_t b = (v & 0x80) ? (~v << 1) : (v << 1);
+    hb(hue + (c.h >> 1), b, led++);
+    geo_next(&c);
+  }
+}
+
+/* Эффекты на основе гладкого шума (см. noise.h). Буфер ленты используется для промежуточных значений шума */
+
+typedef struct {
+  uint16_t t;
+} NoiseState;
+EFFECT_STATE_CHECK(NoiseState);
+
+typedef struct {
+  uint16_t t;
+  uint8_t pal[PALETTE_RAM_SIZE];
+} FireState;
+EFFECT_STATE_CHECK(FireState);
+
+// Пламя, поднимающееся снизу вверх и остывающее к верхушке
+void fire(EffectZone * z) {
+  FireState * s = EFFECT_STATE(z, FireState);
+  if (z->init) {
+    s->t = xrnd16();
+    palette_load(0, s->pal);
+  }
+  uint16_t t = s->t;
+  s->t += 3;
+  noise_run(&z->leds[0].r, 3, ZONE_NUM(z), -(t << 4), 0x40, t << 2, 2);
+  GeoCursor c;
+  geo_seek(&c, z->leds - mem.leds);
+  led_rec * led = z->leds;
+  for (led_idx_t i = ZONE_NUM(z); i; i--) {
+    uint8_t heat = led->r;
+    heat = (heat > c.h) ? (heat - c.h) : 0;
+    // Палитра циклическая: индексы выше 240 снова ведут к чёрному, поэтому ограничиваем ими
+    led->r = (heat >= 120) ? 240 : (heat << 1);
+    led++;
+    geo_next(&c);
+  }
+  palette_map(s->pal, z->leds, ZONE_NUM(z));
+}
+
+// Северное сияние: медленно переливающиеся зелёно-сине-фиолетовые занавеси
+void aurora(EffectZone * z) {
+  NoiseState * s = EFFECT_STATE(z, NoiseState);
+  if (z->init) {
+    s->t = xrnd16();
+  }
+  uint16_t t = s->t++;
+  noise_run(&z->leds[0].r, 3, ZONE_NUM(z), t << 3, 0x18, t << 1, 3);
+  noise_run(&z->leds[0].g, 3, ZONE_NUM(z), t, 0x0C, 0x8000 - t, 1);
+  led_rec * led = z->leds;
+  for (led_idx_t i = ZONE_NUM(z); i; i--) {
+    uint8_t b = led->r;
+    b = (b * b) >> 8; // Контрастнее: узкие яркие полосы на тёмном фоне
+    hb(96 + (led->g >> 1), b, led);
+    led++;
+  }
+}
+
+typedef struct {
+  uint16_t t;
+  uint16_t shift;
+  uint8_t pal[PALETTE_RAM_SIZE];
+} PaletteWavesState;
+EFFECT_STATE_CHECK(PaletteWavesState);
+
+// Переливы случайно выбранной палитры, включая пользовательские
+void palette_waves(EffectZone * z) {
+  PaletteWavesState * s = EFFECT_STATE(z, PaletteWavesState);
+  if (z->init) {
+    s->t = xrnd16();
+    s->shift = xrnd16();
+    palette_load(xrnd8_below(num_palettes), s->pal);
+  }
+  uint16_t t = s->t++;
+  s->shift += 40;
+  noise_run(&z->leds[0].r, 3, ZONE_NUM(z), t << 2, 0x20, t, 2);
+  led_rec * led = z->leds;
+  uint8_t sh = s->shift >> 8;
+  for (led_idx_t i = ZONE_NUM(z); i; i--) {
+    led->r += sh;
+    led++;
+  }
+  palette_map(s->pal, z->leds, ZONE_NUM(z));
 }
 
 PROGMEM const char str_wave[] = "Wave";
@@ -466,6 +683,16 @@ PROGMEM const char str_twist[] = "Twist";
 PROGMEM const char str_meteors[] = "Meteors";
 PROGMEM const char str_interference[] = "Interference";
 PROGMEM const char str_metamorphosis[] = "Metamorphosis";
+PROGMEM const char str_anim_twinkle[] = "Twinkle";
+PROGMEM const char str_vm_0[] = "Bytecode 1";
+PROGMEM const char str_vm_1[] = "Bytecode 2";
+PROGMEM const char str_vm_2[] = "Bytecode 3";
+PROGMEM const char str_vm_3[] = "Bytecode 4";
+PROGMEM const char str_sweep[] = "Sweep";
+PROGMEM const char str_spiral[] = "Spiral";
+PROGMEM const char str_fire[] = "Fire";
+PROGMEM const char str_aurora[] = "Aurora";
+PROGMEM const char str_palette_waves[] = "Palette waves";
 
 PROGMEM const EffectDesc effects_list[] = {
   {str_wave, wave},
@@ -475,7 +702,17 @@ PROGMEM const EffectDesc effects_list[] = {
   {str_twist, twist},
   {str_meteors, meteors},
   {str_interference, interference},
-  {str_metamorphosis, metamorphosis}
+  {str_metamorphosis, metamorphosis},
+  {str_anim_twinkle, anim_twinkle_effect},
+  {str_vm_0, vm_effect_0},
+  {str_vm_1, vm_effect_1},
+  {str_vm_2, vm_effect_2},
+  {str_vm_3, vm_effect_3},
+  {str_sweep, sweep},
+  {str_spiral, spiral},
+  {str_fire, fire},
+  {str_aurora, aurora},
+  {str_palette_waves, palette_waves}
 };  
 
 const uint8_t num_effects = sizeof(effects_list) / sizeof(EffectDesc);
@@ -13,11 +13,34 @@
 #include <avr/pgmspace.h>
 #include "Yolka.h"
 
+#define EFFECT_STATE_SIZE 88 // Размер области для хранения состояния эффекта между кадрами
+
+// Зона ленты, в которой отрисовывается эффект
+typedef struct {
+  led_rec * leds; // Первый светодиод зоны
+  uint16_t num; // Количество светодиодов в зоне
+  uint8_t init; // Не ноль в первом кадре: эффект должен проинициализировать своё состояние
+  uint8_t * st; // Состояние эффекта между кадрами, EFFECT_STATE_SIZE байт
+} EffectZone;
+
 typedef struct {
   PGM_VOID_P effect_name;
-  void(*effect)(void);
+  void(*effect)(EffectZone * z); // Отрисовывает очередной кадр эффекта в зоне z
 } EffectDesc;
 
+// Количество светодиодов в зоне. При фиксированной длине ленты зона всегда одна, и это - константа
+#ifdef FIXED_LED_COUNT
+  #define ZONE_NUM(z) ((led_idx_t)FIXED_LED_COUNT)
+#else
+  #define ZONE_NUM(z) ((z)->num)
+#endif
+
+// Указатель на состояние эффекта заданного типа
+#define EFFECT_STATE(z, type) ((type *)((z)->st))
+
+// Проверка при компиляции, что состояние эффекта умещается в отведённую область
+#define EFFECT_STATE_CHECK(type) _Static_assert(sizeof(type) <= EFFECT_STATE_SIZE, #type " does not fit EFFECT_STATE_SIZE")
+
 typedef union {
   led_rec leds[MAX_LED_COUNT];
 } MemoryBlock;
@@ -27,4 +50,22 @@ extern const uint8_t num_effects;
 
 extern MemoryBlock mem;
 
+/* Заполняет нулями count светодиодов начиная с led */
+void clear(led_rec * led, uint16_t count);
+
+/* Размывает изображение на count светодиодах начиная с led */
+void blur(led_rec * led, uint16_t count);
+
+/* Табличный синус: round(sin(2.0 * M_PI * (period / 65536)) * scaler) */
+int16_t sin_t(uint16_t period, int16_t scaler);
+
+/* Преобразование оттенка (h) и яркости (b) в rgb */
+void hb(uint8_t h, uint8_t b, led_rec * led);
+
+/* Преобразование оттенка (h), насыщенности (s) и яркости (b) в rgb */
+void hsb(uint8_t h, uint8_t s, uint8_t b, led_rec * led);
+
+/* Преобразование оттенка (h) и яркости (b) в rgb с пересветом: b от 256 до 511 приближает цвет к белому */
+void hbover(uint8_t h, uint16_t b, led_rec * led);
+
 #endif /* EFFECTS_H_ */
\ No newline at end of file
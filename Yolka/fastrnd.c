@@ -0,0 +1,41 @@
+﻿/*
+ * fastrnd.c
+ *
+ * Быстрые генераторы псевдослучайных чисел с маленьким состоянием, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include "fastrnd.h"
+
+uint16_t xrnd16_state = 1;
+uint8_t xrnd8_state[4] = {1, 0, 0, 0};
+
+void fastrnd_seed(uint32_t seed) {
+  xrnd16_state = seed ^ (seed >> 16);
+  if (!xrnd16_state) xrnd16_state = 1;
+  xrnd8_state[0] = seed;
+  xrnd8_state[1] = seed >> 8;
+  xrnd8_state[2] = seed >> 16;
+  xrnd8_state[3] = seed >> 24;
+  if (!seed) xrnd8_state[0] = 1;
+}
+
+void xrnd_fill(void * buf, uint16_t len) {
+  uint8_t * p = buf;
+  // Состояние - в локальных переменных, чтобы компилятор держал его в регистрах на протяжении всего цикла
+  uint8_t x = xrnd8_state[0], y = xrnd8_state[1], z = xrnd8_state[2], w = xrnd8_state[3];
+  while (len--) {
+    uint8_t t = x ^ (uint8_t)(x << 3);
+    x = y;
+    y = z;
+    z = w;
+    w ^= (w >> 2) ^ t ^ (t >> 5);
+    *(p++) = w;
+  }
+  xrnd8_state[0] = x;
+  xrnd8_state[1] = y;
+  xrnd8_state[2] = z;
+  xrnd8_state[3] = w;
+}
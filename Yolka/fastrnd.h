@@ -0,0 +1,65 @@
+﻿/*
+ * fastrnd.h
+ *
+ * Быстрые генераторы псевдослучайных чисел с маленьким состоянием, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef FASTRND_H_
+#define FASTRND_H_
+
+#include <avr/io.h>
+
+/* random16() из Yolka.c - 32 битный линейный конгруэнтный генератор: на каждое число программное умножение 32x32,
+ * а randomw()/random() добавляют ещё одно. Здесь - генераторы на сдвигах и исключающем ИЛИ, которые целиком живут в регистрах:
+ *   xrnd16() - xorshift16 (7, 9, 8), период 65535;
+ *   xrnd8() - xorshift на четырёх байтах (3, 5, 2), период 2^32 - 1, только 8 битные операции.
+ * Ограничение диапазона - умножением 8x8 (одна инструкция mul) или 16x16 вместо 32 битного.
+ * Для эффектов, где важна скорость, а не качество. Состояние не может быть нулевым, fastrnd_seed это учитывает.
+ */
+
+extern uint16_t xrnd16_state;
+extern uint8_t xrnd8_state[4];
+
+/* Инициализирует состояние генераторов */
+void fastrnd_seed(uint32_t seed);
+
+/* Заполняет буфер случайными байтами */
+void xrnd_fill(void * buf, uint16_t len);
+
+/* 16 битное случайное число */
+static inline uint16_t xrnd16() {
+  uint16_t x = xrnd16_state;
+  x ^= x << 7;
+  x ^= x >> 9;
+  x ^= x << 8;
+  xrnd16_state = x;
+  return x;
+}
+
+/* 8 битное случайное число */
+static inline uint8_t xrnd8() {
+  uint8_t x = xrnd8_state[0];
+  uint8_t w = xrnd8_state[3];
+  uint8_t t = x ^ (uint8_t)(x << 3);
+  xrnd8_state[0] = xrnd8_state[1];
+  xrnd8_state[1] = xrnd8_state[2];
+  xrnd8_state[2] = w;
+  w ^= (w >> 2) ^ t ^ (t >> 5);
+  xrnd8_state[3] = w;
+  return w;
+}
+
+/* Случайное число меньше чем n (8x8 умножение) */
+static inline uint8_t xrnd8_below(uint8_t n) {
+  return (xrnd8() * n) >> 8;
+}
+
+/* Случайное число меньше чем n (16x16 умножение, берётся старшая половина) */
+static inline uint16_t xrnd16_below(uint16_t n) {
+  return ((uint32_t)xrnd16() * n) >> 16;
+}
+
+#endif /* FASTRND_H_ */
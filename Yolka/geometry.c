@@ -0,0 +1,138 @@
+﻿/*
+ * geometry.c
+ *
+ * Пространственное расположение светодиодов на ёлке, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "geometry.h"
+#include "Yolka.h"
+
+#ifdef GEOMETRY_TABLE
+
+#include "geometry_data.h"
+
+static void geo_read(GeoCursor * c) {
+  c->h = pgm_read_byte(c->p);
+  c->a = pgm_read_byte(c->p + 1);
+  c->r = pgm_read_byte(c->p + 2);
+}
+
+void geo_seek(GeoCursor * c, uint16_t i) {
+  c->i = i;
+  if (i >= GEOMETRY_TABLE_LEDS) i = GEOMETRY_TABLE_LEDS - 1;
+  c->p = &geometry_table[i * 3];
+  geo_read(c);
+}
+
+void geo_next(GeoCursor * c) {
+  if (++c->i < GEOMETRY_TABLE_LEDS) {
+    c->p += 3;
+    geo_read(c);
+  }
+}
+
+#else
+
+#include "eeprom.h"
+
+typedef struct {
+  uint16_t idx;
+  uint8_t h, r;
+  uint16_t a;
+} GeoAnchor;
+
+static uint8_t geo_anchors_count() {
+  uint8_t cnt = eeprom_read(EE_GEOMETRY, 0);
+  return ((cnt < 2) || (cnt > GEO_MAX_ANCHORS)) ? 0 : cnt;
+}
+
+static void geo_anchor(uint8_t cnt, uint8_t n, GeoAnchor * p) {
+  if (!cnt) { // Спираль по конусу: от нижнего края к верхушке
+    if (!n) {
+      p->idx = 0;
+      p->h = 0;
+      p->r = 255;
+      p->a = 0;
+    } else {
+      p->idx = (led_num > 1) ? (led_num - 1) : 1;
+      p->h = 255;
+      p->r = 0;
+      p->a = GEO_DEFAULT_TURNS * 256;
+    }
+    return;
+  }
+  uint16_t ee = EE_GEOMETRY + 1 + n * GEO_ANCHOR_SIZE;
+  p->idx = eeprom_read_uint16(ee, 0);
+  p->h = eeprom_read(ee + 2, 0xFF);
+  p->r = eeprom_read(ee + 3, 0xFF);
+  p->a = eeprom_read_uint16(ee + 4, 0);
+}
+
+/* Настраивает курсор на участок, начинающийся с опорной точки n (или до первой опорной точки, если i меньше её номера), 
+ * и переводит его на светодиод i */
+static void geo_segment(GeoCursor * c, uint8_t n, uint16_t i) {
+  uint8_t cnt = geo_anchors_count();
+  uint8_t last = cnt ? (cnt - 1) : 1;
+  GeoAnchor p0, p1;
+  geo_anchor(cnt, n, &p0);
+  c->fh = p0.h << 8;
+  c->fr = p0.r << 8;
+  c->fa = p0.a << 8;
+  c->dh = c->dr = c->da = 0;
+  if (i < p0.idx) { // До первой опорной точки - координаты постоянны
+    c->seg_end = p0.idx;
+    c->anchor = n;
+  } else if (n >= last) { // После последней - тоже
+    c->seg_end = 0xFFFF;
+    c->anchor = n;
+  } else {
+    geo_anchor(cnt, n + 1, &p1);
+    uint16_t len = p1.idx - p0.idx;
+    // Деление - один раз на участок, а не на каждый светодиод
+    c->dh = ((int32_t)(p1.h - p0.h) << 8) / (int16_t)len;
+    c->dr = ((int32_t)(p1.r - p0.r) << 8) / (int16_t)len;
+    c->da = ((int32_t)(int16_t)(p1.a - p0.a) << 8) / (int16_t)len; // Угол циклический, поэтому переполнение не страшно
+    c->seg_end = p1.idx;
+    c->anchor = n + 1;
+    uint16_t k = i - p0.idx;
+    c->fh += c->dh * k;
+    c->fr += c->dr * k;
+    c->fa += c->da * k;
+  }
+  c->i = i;
+  c->h = c->fh >> 8;
+  c->r = c->fr >> 8;
+  c->a = c->fa >> 8;
+}
+
+void geo_seek(GeoCursor * c, uint16_t i) {
+  uint8_t cnt = geo_anchors_count();
+  uint8_t n = 0;
+  if (cnt) {
+    // Ищем последнюю опорную точку с номером светодиода не больше i
+    while ((n < (cnt - 1)) && (eeprom_read_uint16(EE_GEOMETRY + 1 + (n + 1) * GEO_ANCHOR_SIZE, 0) <= i)) n++;
+  } else if (i >= led_num - 1) {
+    n = 1;
+  }
+  geo_segment(c, n, i);
+}
+
+void geo_next(GeoCursor * c) {
+  uint16_t i = ++c->i;
+  if (i == c->seg_end) {
+    geo_segment(c, c->anchor, i);
+    return;
+  }
+  c->fh += c->dh;
+  c->fr += c->dr;
+  c->fa += c->da;
+  c->h = c->fh >> 8;
+  c->r = c->fr >> 8;
+  c->a = c->fa >> 8;
+}
+
+#endif
@@ -0,0 +1,60 @@
+﻿/*
+ * geometry.h
+ *
+ * Пространственное расположение светодиодов на ёлке, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+#include <avr/io.h>
+
+/* Координаты каждого светодиода - высота h (0 - низ, 255 - верхушка), угол a вокруг ствола (256 соответствует полному обороту)
+ * и расстояние от ствола r (255 - самая дальняя точка).
+ *
+ * Источник координат:
+ * - если определено GEOMETRY_TABLE - таблица во флеш-памяти (geometry_data.h), полученная утилитой Tools/geometry.py 
+ *   из измеренных координат светодиодов. Светодиоды за пределами таблицы получают координаты последнего из описанных.
+ * - иначе - опорные точки в EEPROM, задаваемые командой 'G','W'. Между опорными точками координаты интерполируются линейно.
+ *   Если опорные точки не заданы, считается что гирлянда навита спиралью снизу вверх по конусу в GEO_DEFAULT_TURNS оборотов.
+ */
+//#define GEOMETRY_TABLE
+
+/* Опорные точки в EEPROM: count, затем count записей по GEO_ANCHOR_SIZE байт:
+ *   idx_lo, idx_hi - номер светодиода (строго возрастают)
+ *   h, r - высота и расстояние от ствола
+ *   a_lo, a_hi - угол с учётом полных оборотов, 256 на оборот (т.е. направление и число витков между точками однозначны)
+ */
+#define EE_GEOMETRY 800 // За описанием зон (EE_ZONES + 1 + MAX_ZONES * ZONE_REC_SIZE)
+#define GEO_MAX_ANCHORS 10
+#define GEO_ANCHOR_SIZE 6
+
+#define GEO_DEFAULT_TURNS 6
+
+/* Курсор для последовательного обхода светодиодов: переход к следующему светодиоду стоит нескольких сложений
+ * (или чтения таблицы), без деления и тригонометрии на каждый светодиод */
+typedef struct {
+  uint8_t h, a, r; // Координаты текущего светодиода
+  // Далее - внутреннее состояние
+  uint16_t i;
+#ifdef GEOMETRY_TABLE
+  const uint8_t * p;
+#else
+  uint16_t fh, fa, fr; // Координаты в формате 8.8
+  int16_t dh, dr;
+  uint16_t da;
+  uint16_t seg_end; // Номер светодиода, на котором заканчивается текущий участок
+  uint8_t anchor; // Номер опорной точки в конце текущего участка
+#endif
+} GeoCursor;
+
+/* Устанавливает курсор на светодиод номер i (номер от начала ленты, а не зоны) */
+void geo_seek(GeoCursor * c, uint16_t i);
+
+/* Переводит курсор на следующий светодиод */
+void geo_next(GeoCursor * c);
+
+#endif /* GEOMETRY_H_ */
@@ -0,0 +1,28 @@
+﻿/*
+ * geometry_data.h
+ *
+ * Таблица координат светодиодов, проект "Ёлка"
+ * Файл сгенерирован утилитой Tools/geometry.py, вручную не редактировать:
+ *   python geometry.py --cone 50 --turns 6
+ */ 
+
+
+#ifndef GEOMETRY_DATA_H_
+#define GEOMETRY_DATA_H_
+
+// 50 LEDs: h, a, r
+#define GEOMETRY_TABLE_LEDS 50
+const PROGMEM uint8_t geometry_table[GEOMETRY_TABLE_LEDS * 3] = {
+  0, 0, 255, 5, 31, 250, 10, 63, 245, 16, 94, 239, 21, 125, 234,
+  26, 157, 229, 31, 188, 224, 36, 219, 219, 42, 251, 213, 47, 26, 208,
+  52, 57, 203, 57, 89, 198, 62, 120, 193, 68, 152, 187, 73, 183, 182,
+  78, 214, 177, 83, 246, 172, 88, 21, 167, 94, 52, 161, 99, 84, 156,
+  104, 115, 151, 109, 146, 146, 114, 178, 141, 120, 209, 135, 125, 240, 130,
+  130, 16, 125, 135, 47, 120, 141, 78, 114, 146, 110, 109, 151, 141, 104,
+  156, 172, 99, 161, 204, 94, 167, 235, 88, 172, 10, 83, 177, 42, 78,
+  182, 73, 73, 187, 104, 68, 193, 136, 62, 198, 167, 57, 203, 199, 52,
+  208, 230, 47, 213, 5, 42, 219, 37, 36, 224, 68, 31, 229, 99, 26,
+  234, 131, 21, 239, 162, 16, 245, 193, 10, 250, 225, 5, 255, 0, 0,
+};
+
+#endif /* GEOMETRY_DATA_H_ */
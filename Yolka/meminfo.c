@@ -0,0 +1,35 @@
+﻿/*
+ * meminfo.c
+ *
+ * Учёт использования ОЗУ и глубины стека, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include "meminfo.h"
+
+extern uint8_t _end; // Конец статических переменных, определяется компоновщиком
+extern uint8_t __stack; // Начальная вершина стека (RAMEND)
+
+/* Выполняется в секции .init3: указатель стека уже установлен, r1 обнулён, а статические переменные ещё не инициализированы.
+ * Функция не имеет пролога и ничего не кладёт на стек, поэтому заполнять можно до самой вершины */
+void meminfo_paint() __attribute__((naked, used, section(".init3")));
+void meminfo_paint() {
+  uint8_t * p = &_end;
+  while (p <= &__stack) *(p++) = MEMINFO_CANARY;
+}
+
+uint16_t meminfo_stack_unused() {
+  uint8_t * p = &_end;
+  while ((p <= &__stack) && (*p == MEMINFO_CANARY)) p++;
+  return p - &_end;
+}
+
+uint16_t meminfo_stack_free() {
+  return SP - (uint16_t)&_end;
+}
+
+uint16_t meminfo_static_size() {
+  return (uint16_t)&_end - RAMSTART;
+}
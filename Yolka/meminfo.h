@@ -0,0 +1,32 @@
+﻿/*
+ * meminfo.h
+ *
+ * Учёт использования ОЗУ и глубины стека, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef MEMINFO_H_
+#define MEMINFO_H_
+
+#include <avr/io.h>
+
+/* При старте, ещё до main, всё ОЗУ между концом статических переменных (_end) и вершиной стека заполняется байтом MEMINFO_CANARY.
+ * Стек растёт вниз, навстречу статическим переменным, и затирает заполнение. По тому, сколько байт заполнения уцелело снизу,
+ * можно судить о наибольшей глубине стека за всё время работы. 
+ * Если функция резервирует на стеке массив, но не пишет в его часть, уцелевшие байты будут засчитаны как свободные,
+ * поэтому оценка приблизительная: запас в несколько десятков байт стоит держать всегда.
+ */
+#define MEMINFO_CANARY 0xC5
+
+/* Количество байт ОЗУ между статическими переменными и стеком, которые стек не затрагивал с момента запуска */
+uint16_t meminfo_stack_unused();
+
+/* Количество байт ОЗУ между статическими переменными и текущей вершиной стека */
+uint16_t meminfo_stack_free();
+
+/* Объём статических переменных (.data и .bss), байт */
+uint16_t meminfo_static_size();
+
+#endif /* MEMINFO_H_ */
@@ -0,0 +1,110 @@
+﻿/*
+ * noise.c
+ *
+ * Гладкий 8 битный шум для "природных" эффектов, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "noise.h"
+
+// Таблица перестановок чисел 0..255
+static const PROGMEM uint8_t noise_perm[256] = {
+  25, 159, 64, 78, 144, 222, 193, 132, 148, 151, 46, 15, 63, 82, 187, 172,
+  90, 155, 54, 79, 214, 124, 24, 249, 125, 14, 32, 165, 227, 208, 235, 150,
+  57, 246, 84, 108, 170, 81, 36, 213, 83, 160, 102, 52, 119, 225, 21, 198,
+  49, 48, 209, 219, 251, 26, 19, 202, 188, 200, 177, 184, 56, 87, 141, 205,
+  138, 146, 18, 97, 28, 231, 55, 85, 99, 233, 103, 86, 121, 35, 171, 157,
+  104, 116, 37, 112, 23, 201, 2, 210, 72, 80, 92, 194, 127, 156, 40, 142,
+  120, 216, 77, 232, 111, 139, 118, 7, 70, 96, 239, 234, 45, 197, 176, 129,
+  50, 215, 43, 174, 12, 66, 93, 192, 67, 58, 143, 179, 199, 130, 44, 4,
+  236, 68, 238, 253, 203, 0, 180, 149, 136, 147, 17, 41, 178, 13, 185, 229,
+  211, 115, 223, 161, 94, 134, 114, 60, 51, 153, 53, 11, 71, 182, 65, 5,
+  126, 241, 88, 123, 59, 62, 98, 1, 135, 218, 189, 181, 252, 133, 74, 76,
+  9, 247, 105, 128, 206, 245, 42, 207, 6, 220, 228, 168, 212, 164, 113, 106,
+  27, 158, 175, 69, 91, 95, 244, 255, 16, 47, 20, 109, 122, 224, 240, 173,
+  242, 31, 38, 61, 226, 73, 230, 140, 101, 30, 100, 117, 137, 195, 162, 221,
+  169, 154, 3, 75, 29, 243, 248, 145, 8, 89, 191, 110, 152, 217, 183, 34,
+  237, 196, 107, 131, 167, 204, 22, 186, 254, 190, 33, 10, 250, 166, 163, 39,
+};
+
+#define P(i) pgm_read_byte(&noise_perm[(uint8_t)(i)])
+
+// Сглаживание: f * f * (3 - 2 * f). Все промежуточные произведения укладываются в 16 бит
+static inline uint8_t ease8(uint8_t f) {
+  uint8_t f2 = (f * f) >> 8;
+  return (f2 * (768 - 2 * f)) >> 8;
+}
+
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t t) {
+  return a + (((int16_t)(b - a) * t) >> 8);
+}
+
+uint8_t noise8_1d(uint16_t x) {
+  uint8_t xi = x >> 8;
+  return lerp8(P(xi), P(xi + 1), ease8(x));
+}
+
+uint8_t noise8_2d(uint16_t x, uint16_t y) {
+  uint8_t xi = x >> 8;
+  uint8_t yi = y >> 8;
+  uint8_t a = P(xi) + yi;
+  uint8_t b = P(xi + 1) + yi;
+  uint8_t ey = ease8(y);
+  uint8_t v0 = lerp8(P(a), P(a + 1), ey);
+  uint8_t v1 = lerp8(P(b), P(b + 1), ey);
+  return lerp8(v0, v1, ease8(x));
+}
+
+/* Веса октав: 1/2, 1/4, ..., последняя октава получает вес предыдущей, так что сумма весов - единица */
+#define OCTAVE_SHIFT(o, octaves) (((o) + 1 < (octaves)) ? ((o) + 1) : (o))
+
+// Смещение координат каждой следующей октавы, чтобы узлы октав не совпадали
+#define OCTAVE_OFFSET 0x3B71
+
+uint8_t noise8_2d_oct(uint16_t x, uint16_t y, uint8_t octaves) {
+  if (octaves <= 1) return noise8_2d(x, y);
+  uint8_t res = 0;
+  for (uint8_t o = 0; o < octaves; o++) {
+    res += noise8_2d(x, y) >> OCTAVE_SHIFT(o, octaves);
+    x = (x << 1) + OCTAVE_OFFSET;
+    y = (y << 1) + OCTAVE_OFFSET;
+  }
+  return res;
+}
+
+static void noise_pass(uint8_t * dst, uint8_t stride, uint16_t count, uint16_t x, uint16_t dx, uint16_t y, uint8_t shift, uint8_t add) {
+  uint8_t yi = y >> 8;
+  uint8_t ey = ease8(y);
+  uint8_t xi = ~(x >> 8); // Заведомо не совпадает с первой ячейкой
+  uint8_t v0 = 0, v1 = 0;
+  while (count--) {
+    uint8_t cx = x >> 8;
+    if (cx != xi) {
+      xi = cx;
+      uint8_t a = P(xi) + yi;
+      uint8_t b = P(xi + 1) + yi;
+      v0 = lerp8(P(a), P(a + 1), ey);
+      v1 = lerp8(P(b), P(b + 1), ey);
+    }
+    uint8_t v = lerp8(v0, v1, ease8(x)) >> shift;
+    *dst = add ? (*dst + v) : v;
+    dst += stride;
+    x += dx;
+  }
+}
+
+void noise_run(uint8_t * dst, uint8_t stride, uint16_t count, uint16_t x, uint16_t dx, uint16_t y, uint8_t octaves) {
+  if (octaves <= 1) {
+    noise_pass(dst, stride, count, x, dx, y, 0, 0);
+    return;
+  }
+  for (uint8_t o = 0; o < octaves; o++) {
+    noise_pass(dst, stride, count, x, dx, y, OCTAVE_SHIFT(o, octaves), o);
+    x = (x << 1) + OCTAVE_OFFSET;
+    dx <<= 1;
+    y = (y << 1) + OCTAVE_OFFSET;
+  }
+}
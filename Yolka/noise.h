@@ -0,0 +1,34 @@
+﻿/*
+ * noise.h
+ *
+ * Гладкий 8 битный шум для "природных" эффектов, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef NOISE_H_
+#define NOISE_H_
+
+#include <avr/io.h>
+
+/* Шум по значениям (value noise): в узлах целочисленной решётки - псевдослучайные значения из таблицы перестановок,
+ * между узлами - сглаженная (smoothstep) интерполяция. Координаты - в формате 8.8: старший байт - номер узла,
+ * младший - положение между узлами. Период по каждой координате - 256 узлов. Результат - от 0 до 255.
+ */
+
+/* Одномерный шум */
+uint8_t noise8_1d(uint16_t x);
+
+/* Двумерный шум */
+uint8_t noise8_2d(uint16_t x, uint16_t y);
+
+/* Двумерный шум, сумма octaves октав: каждая следующая - с вдвое большей частотой и вдвое меньшей амплитудой */
+uint8_t noise8_2d_oct(uint16_t x, uint16_t y, uint8_t octaves);
+
+/* Заполняет count байт, расположенных с шагом stride начиная с dst, значениями noise8_2d_oct(x + i * dx, y, octaves).
+ * Узлы решётки пересчитываются только при переходе в следующую ячейку, поэтому на светодиод приходится одна интерполяция на октаву.
+ * stride = 3 позволяет писать прямо в один из каналов mem.leds, используя буфер ленты как промежуточный */
+void noise_run(uint8_t * dst, uint8_t stride, uint16_t count, uint16_t x, uint16_t dx, uint16_t y, uint8_t octaves);
+
+#endif /* NOISE_H_ */
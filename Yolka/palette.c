@@ -0,0 +1,80 @@
+﻿/*
+ * palette.c
+ *
+ * Палитры: цветовые градиенты из 16 опорных цветов, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "palette.h"
+#include "eeprom.h"
+#include "tools.h"
+
+static const PROGMEM uint8_t pal_fire[PALETTE_DATA_SIZE] = {
+  0, 0, 0, 32, 0, 0, 64, 0, 0, 96, 0, 0, 128, 0, 0, 160, 10, 0, 192, 20, 0, 223, 30, 0,
+  255, 40, 0, 255, 73, 0, 255, 107, 0, 255, 140, 0, 255, 180, 20, 255, 220, 40, 255, 238, 120, 255, 255, 200
+};
+
+static const PROGMEM uint8_t pal_ice[PALETTE_DATA_SIZE] = {
+  0, 0, 40, 0, 10, 70, 0, 20, 100, 0, 30, 130, 0, 40, 160, 10, 70, 184, 20, 100, 208, 30, 130, 231,
+  40, 160, 255, 80, 180, 255, 120, 200, 255, 160, 220, 255, 200, 240, 255, 133, 160, 183, 67, 80, 112, 0, 0, 40
+};
+
+static const PROGMEM uint8_t pal_warm[PALETTE_DATA_SIZE] = {
+  60, 20, 2, 109, 45, 6, 158, 70, 11, 206, 95, 16, 255, 120, 20, 255, 135, 35, 255, 150, 50, 255, 165, 65,
+  255, 180, 80, 255, 165, 65, 255, 150, 50, 255, 135, 35, 255, 120, 20, 190, 87, 14, 125, 53, 8, 60, 20, 2
+};
+
+static const PROGMEM uint8_t pal_ocean[PALETTE_DATA_SIZE] = {
+  0, 0, 60, 0, 15, 80, 0, 30, 100, 0, 45, 120, 0, 60, 140, 0, 85, 145, 0, 110, 150, 0, 135, 155,
+  0, 160, 160, 27, 180, 173, 53, 200, 187, 80, 220, 200, 60, 165, 165, 40, 110, 130, 20, 55, 95, 0, 0, 60
+};
+
+static const PROGMEM uint8_t pal_forest[PALETTE_DATA_SIZE] = {
+  0, 40, 0, 5, 60, 0, 10, 80, 0, 15, 100, 0, 20, 120, 0, 45, 130, 5, 70, 140, 10, 95, 150, 15,
+  120, 160, 20, 90, 142, 22, 60, 125, 25, 30, 108, 28, 0, 90, 30, 0, 73, 20, 0, 57, 10, 0, 40, 0
+};
+
+static const PROGMEM uint8_t pal_party[PALETTE_DATA_SIZE] = {
+  90, 0, 160, 127, 0, 137, 163, 0, 113, 200, 0, 90, 218, 20, 60, 237, 40, 30, 255, 60, 0, 237, 93, 0,
+  218, 127, 0, 200, 160, 0, 133, 160, 27, 67, 160, 53, 0, 160, 80, 13, 107, 120, 27, 53, 160, 40, 0, 200
+};
+
+static const PROGMEM char str_pal_fire[] = "Fire";
+static const PROGMEM char str_pal_ice[] = "Ice";
+static const PROGMEM char str_pal_warm[] = "Warm white";
+static const PROGMEM char str_pal_ocean[] = "Ocean";
+static const PROGMEM char str_pal_forest[] = "Forest";
+static const PROGMEM char str_pal_party[] = "Party";
+
+PROGMEM const PGM_VOID_P palettes_list[] = {
+  pal_fire, pal_ice, pal_warm, pal_ocean, pal_forest, pal_party
+};
+
+PROGMEM const PGM_VOID_P palette_names[] = {
+  str_pal_fire, str_pal_ice, str_pal_warm, str_pal_ocean, str_pal_forest, str_pal_party
+};
+
+const uint8_t num_builtin_palettes = arraysize(palettes_list);
+
+void palette_load(uint8_t n, uint8_t * pal) {
+  if (n >= num_builtin_palettes) {
+    uint8_t u = n - num_builtin_palettes;
+    if ((u < PALETTE_USER) && !(eeprom_read(EE_PALETTES, 0xFF) & (1 << u))) {
+      uint16_t ee = EE_PALETTES + 1 + u * PALETTE_DATA_SIZE;
+      for (uint8_t i = 0; i < PALETTE_DATA_SIZE; i++) {
+        pal[i] = eeprom_read(ee++, 0xFF);
+      }
+      pal[PALETTE_DATA_SIZE] = pal[0];
+      pal[PALETTE_DATA_SIZE + 1] = pal[1];
+      pal[PALETTE_DATA_SIZE + 2] = pal[2];
+      return;
+    }
+    n = 0;
+  }
+  PGM_VOID_P p = pgm_read_ptr(&palettes_list[n]);
+  memcpy_P(pal, p, PALETTE_DATA_SIZE);
+  memcpy_P(pal + PALETTE_DATA_SIZE, p, 3);
+}
@@ -0,0 +1,52 @@
+﻿/*
+ * palette.h
+ *
+ * Палитры: цветовые градиенты из 16 опорных цветов, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#define PALETTE_STOPS 16 // Количество опорных цветов в палитре
+#define PALETTE_DATA_SIZE (PALETTE_STOPS * 3) // Размер палитры во флеш-памяти и в EEPROM
+
+/* Размер палитры, загруженной в оперативную память: за последним опорным цветом повторяется первый,
+ * чтобы интерполяция между ними не требовала проверок (палитра циклическая) */
+#define PALETTE_RAM_SIZE (PALETTE_DATA_SIZE + 3)
+
+/* Пользовательские палитры в EEPROM: байт флагов (сброшенный бит n - слот n записан), затем PALETTE_USER слотов по PALETTE_DATA_SIZE байт */
+#define EE_PALETTES 864 // За опорными точками геометрии (EE_GEOMETRY + 1 + GEO_MAX_ANCHORS * GEO_ANCHOR_SIZE)
+#define PALETTE_USER 3
+
+#ifndef __ASSEMBLER__
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "ws2812.h"
+
+extern const PROGMEM PGM_VOID_P palettes_list[];
+extern const PROGMEM PGM_VOID_P palette_names[];
+extern const uint8_t num_builtin_palettes;
+
+// Общее количество палитр: встроенные, затем пользовательские
+#define num_palettes (num_builtin_palettes + PALETTE_USER)
+
+/* Загружает палитру n в pal (PALETTE_RAM_SIZE байт). Незаписанный пользовательский слот заменяется первой встроенной палитрой */
+void palette_load(uint8_t n, uint8_t * pal);
+
+/* Цвет из палитры по индексу idx: 16 единиц индекса на каждый интервал между опорными цветами */
+extern void palette_color(const uint8_t * pal, uint8_t idx, led_rec * led);
+
+/* Градиент на count светодиодов: индекс idx (в формате 8.8) на каждом следующем светодиоде увеличивается на step */
+extern void palette_fill(const uint8_t * pal, led_rec * led, uint16_t count, uint16_t idx, int16_t step);
+
+/* Заменяет цвет каждого из count светодиодов цветом палитры, индексом для которого служит его компонента r.
+ * Удобно в паре с noise_run, пишущей в канал r */
+extern void palette_map(const uint8_t * pal, led_rec * led, uint16_t count);
+
+#endif
+
+#endif /* PALETTE_H_ */
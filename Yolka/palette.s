@@ -0,0 +1,114 @@
+﻿
+/*
+ * palette.s
+ *
+ * Палитры: выборка цвета с интерполяцией между опорными цветами, проект "Ёлка"
+ *
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+#define _SFR_ASM_COMPAT 1
+#define __SFR_OFFSET 0
+#include "palette.h"
+
+// r18-r27, r30-r31 можно использовать свободно, r1 должен быть обнулён при выходе.
+// Входные параметры: r25:r24 - первый, r23:r22 - второй, r21:r20 - третий, r19:r18 - четвёртый, r17:r16 - пятый (не изменяется)
+
+// Z указывает на опорный цвет k, r22 - вес следующего цвета g (0..240), X - куда записать результат.
+// Компонента: (c0 * (256 - g) + c1 * g) >> 8 = (c0 * 256 - c0 * g + c1 * g) >> 8. Промежуточная сумма не выходит за 0..65535
+// Портит r0, r1, r23, r24, r25. 14 тактов на компоненту
+.macro PAL_MIX o0, o1
+  ldd r25, Z+\o0
+  clr r24
+  mul r25, r22
+  sub r24, r0
+  sbc r25, r1
+  ldd r23, Z+\o1
+  mul r23, r22
+  add r24, r0
+  adc r25, r1
+  st X+, r25
+.endm
+
+// Z = pal + k * 3, где k - старшие 4 бита \idx. pal - в \lo:\hi. Портит r23
+.macro PAL_STOP idx, lo, hi
+  mov r23, \idx
+  swap r23
+  andi r23, 0x0F
+  mov r30, r23
+  lsl r30
+  add r30, r23
+  clr r31
+  add r30, \lo
+  adc r31, \hi
+.endm
+
+.global palette_color
+.global palette_fill
+.global palette_map
+
+// void palette_color(const uint8_t * pal, uint8_t idx, led_rec * led)
+palette_color:
+  movw r26, r20
+  PAL_STOP r22, r24, r25
+  swap r22
+  andi r22, 0xF0
+  PAL_MIX 0, 3
+  PAL_MIX 1, 4
+  PAL_MIX 2, 5
+  clr r1
+ret
+
+// void palette_fill(const uint8_t * pal, led_rec * led, uint16_t count, uint16_t idx, int16_t step)
+palette_fill:
+  push r28
+  push r29
+  movw r28, r24 // Y - палитра
+  movw r26, r22 // X - светодиоды
+  mov r24, r20
+  or r24, r21
+  breq palette_fill_exit
+  palette_fill_loop:
+    PAL_STOP r19, r28, r29
+    // g = младшие 4 бита старшего байта индекса и старшие 4 бита младшего
+    mov r22, r19
+    swap r22
+    andi r22, 0xF0
+    mov r23, r18
+    swap r23
+    andi r23, 0x0F
+    or r22, r23
+    PAL_MIX 0, 3
+    PAL_MIX 1, 4
+    PAL_MIX 2, 5
+    add r18, r16
+    adc r19, r17
+    subi r20, 1
+    sbci r21, 0
+  brne palette_fill_loop
+  palette_fill_exit:
+  clr r1
+  pop r29
+  pop r28
+ret
+
+// void palette_map(const uint8_t * pal, led_rec * led, uint16_t count)
+palette_map:
+  movw r26, r22 // X - светодиоды
+  movw r18, r24 // r19:r18 - палитра
+  mov r24, r20
+  or r24, r21
+  breq palette_map_exit
+  palette_map_loop:
+    ld r22, X // Индекс - в компоненте r, которая сейчас будет перезаписана
+    PAL_STOP r22, r18, r19
+    swap r22
+    andi r22, 0xF0
+    PAL_MIX 0, 3
+    PAL_MIX 1, 4
+    PAL_MIX 2, 5
+    subi r20, 1
+    sbci r21, 0
+  brne palette_map_loop
+  palette_map_exit:
+  clr r1
+ret
@@ -0,0 +1,204 @@
+﻿/*
+ * stream.c
+ *
+ * Приём кадров, передаваемых по сети, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <string.h>
+#include "stream.h"
+#include "wifiman.h"
+#include "effects.h"
+#include "Yolka.h"
+
+led_rec * stream_palette;
+uint16_t stream_palette_size;
+led_rec * stream_back;
+uint8_t stream_pending;
+uint8_t stream_fade;
+
+void stream_begin() {
+  if (stream_back) return;
+  uint16_t free = MAX_LED_COUNT - stream_palette_size;
+  if (free >= led_num * 2) {
+    stream_back = &mem.leds[free - led_num];
+    memcpy(stream_back, mem.leds, led_num * sizeof(led_rec));
+  } else {
+    stream_back = mem.leds;
+  }
+}
+
+void stream_commit() {
+  if (stream_back != mem.leds) memcpy(mem.leds, stream_back, led_num * sizeof(led_rec));
+  stream_fade = 0;
+  stream_pending = 1;
+}
+
+void stream_commit_fade(uint8_t frames) {
+  if ((frames < 2) || (stream_back == mem.leds)) {
+    stream_commit();
+    return;
+  }
+  stream_fade = frames;
+  stream_pending = 1;
+}
+
+void stream_present() {
+  if (stream_fade > 1) {
+    uint16_t recip = 65536UL / stream_fade; // Деление одно на кадр, для каждой компоненты - только умножение
+    uint8_t * f = (uint8_t*)mem.leds;
+    const uint8_t * b = (const uint8_t*)stream_back;
+    for (uint16_t i = led_num * 3; i; i--) {
+      uint8_t c = *f;
+      uint8_t t = *(b++);
+      if (t > c) {
+        c += ((uint32_t)(uint8_t)(t - c) * recip) >> 16;
+      } else {
+        c -= ((uint32_t)(uint8_t)(c - t) * recip) >> 16;
+      }
+      *(f++) = c;
+    }
+    stream_fade--;
+    return;
+  }
+  if (stream_fade) { // Последний шаг: точно приходим к цели
+    memcpy(mem.leds, stream_back, led_num * sizeof(led_rec));
+    stream_fade = 0;
+  }
+  stream_pending = 0;
+}
+
+void stream_read_raw(led_rec * led, uint16_t count) {
+  uint8_t * p = (uint8_t*)led;
+  for (uint16_t i = count * 3; i; i--) {
+    *(p++) = wifiman_read();
+  }
+}
+
+uint16_t stream_data_size(uint8_t format, uint16_t count) {
+  switch (format & STREAM_FORMAT_MASK) {
+    case STREAM_FORMAT_565: return count * 2;
+    case STREAM_FORMAT_444: return count + ((count + 1) >> 1);
+    case STREAM_FORMAT_INDEX: return count;
+  }
+  return count * 3;
+}
+
+static void stream_read_565(led_rec * led, uint16_t count) {
+  for (; count; count--) {
+    uint8_t lo = wifiman_read();
+    uint8_t hi = wifiman_read();
+    uint8_t r = hi & 0xF8;
+    uint8_t g = (hi << 5) | ((lo >> 3) & 0x1C);
+    uint8_t b = lo << 3;
+    // Младшие разряды дополняются старшими, чтобы максимум давал 255
+    led->r = r | (r >> 5);
+    led->g = g | (g >> 6);
+    led->b = b | (b >> 5);
+    led++;
+  }
+}
+
+static void stream_read_444(led_rec * led, uint16_t count) {
+  for (; count >= 2; count -= 2) {
+    uint8_t a = wifiman_read();
+    uint8_t b = wifiman_read();
+    uint8_t c = wifiman_read();
+    led->r = (a & 0xF0) | (a >> 4);
+    led->g = (a & 0x0F) | (a << 4);
+    led->b = (b & 0xF0) | (b >> 4);
+    led++;
+    led->r = (b & 0x0F) | (b << 4);
+    led->g = (c & 0xF0) | (c >> 4);
+    led->b = (c & 0x0F) | (c << 4);
+    led++;
+  }
+  if (count) {
+    uint8_t a = wifiman_read();
+    uint8_t b = wifiman_read();
+    led->r = (a & 0xF0) | (a >> 4);
+    led->g = (a & 0x0F) | (a << 4);
+    led->b = (b & 0xF0) | (b >> 4);
+  }
+}
+
+static void stream_read_index(led_rec * led, uint16_t count) {
+  for (; count; count--) {
+    uint8_t i = wifiman_read();
+    if (i < stream_palette_size) {
+      *led = stream_palette[i];
+    } else {
+      led->r = 0;
+      led->g = 0;
+      led->b = 0;
+    }
+    led++;
+  }
+}
+
+void stream_read(uint8_t format, led_rec * led, uint16_t count) {
+  switch (format & STREAM_FORMAT_MASK) {
+    case STREAM_FORMAT_565: stream_read_565(led, count); break;
+    case STREAM_FORMAT_444: stream_read_444(led, count); break;
+    case STREAM_FORMAT_INDEX: stream_read_index(led, count); break;
+    default: stream_read_raw(led, count);
+  }
+}
+
+uint8_t stream_palette_load(uint16_t count) {
+  // Палитра может занять место буфера приёма, он будет размещён заново вызовом stream_begin()
+  stream_palette_size = 0;
+  stream_back = 0;
+  stream_fade = 0;
+  if ((count > STREAM_PALETTE_MAX) || ((led_num + count) > MAX_LED_COUNT)) return 0;
+  led_rec * pal = &mem.leds[MAX_LED_COUNT - count];
+  stream_read_raw(pal, count);
+  stream_palette = pal;
+  stream_palette_size = count;
+  return 1;
+}
+
+void stream_release() {
+  stream_palette_size = 0;
+  stream_back = 0;
+  stream_pending = 0;
+  stream_fade = 0;
+}
+
+void stream_read_rle(led_rec * led, uint16_t count) {
+  while (count && wifiman_packet_len()) {
+    uint8_t op = wifiman_read();
+    uint8_t n = (op & 0x3F) + 1;
+    if (n > count) n = count; // Команды за пределами ленты отбрасываются
+    count -= n;
+    switch (op & 0xC0) {
+      case STREAM_OP_SKIP:
+        led += n;
+        break;
+      case STREAM_OP_RUN: {
+        uint8_t r = wifiman_read();
+        uint8_t g = wifiman_read();
+        uint8_t b = wifiman_read();
+        for (; n; n--) {
+          led->r = r;
+          led->g = g;
+          led->b = b;
+          led++;
+        }
+      } break;
+      case STREAM_OP_LITERAL:
+        stream_read_raw(led, n);
+        led += n;
+        break;
+      default: { // STREAM_OP_XOR
+        uint8_t * p = (uint8_t*)led;
+        for (uint8_t i = n * 3; i; i--) {
+          *(p++) ^= wifiman_read();
+        }
+        led += n;
+      }
+    }
+  }
+}
@@ -0,0 +1,97 @@
+﻿/*
+ * stream.h
+ *
+ * Приём кадров, передаваемых по сети, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <avr/io.h>
+#include "ws2812.h"
+
+/* Сжатый кадр ('D','C'): байт флагов (STREAM_FRAME_KEY - ключевой кадр), затем команды, пока не будут описаны все светодиоды
+ * либо не закончится пакет (оставшиеся светодиоды при этом пропускаются):
+ *   0x00..0x3F - пропустить (n & 0x3F) + 1 светодиодов, оставив цвет из предыдущего кадра
+ *   0x40..0x7F, r, g, b - (n & 0x3F) + 1 светодиодов одного цвета
+ *   0x80..0xBF, r1, g1, b1, r2... - (n & 0x3F) + 1 светодиодов, каждый своим цветом
+ *   0xC0..0xFF, r1, g1, b1, r2... - (n & 0x3F) + 1 светодиодов, цвет каждого получается XOR с цветом из предыдущего кадра
+ * Ключевой кадр не ссылается на предыдущий: перед декодированием буфер очищается, пропущенные светодиоды остаются чёрными.
+ * Остальные кадры принимаются, только если в буфере лежит предыдущий кадр того же клиента.
+ */
+
+#define STREAM_FRAME_KEY 0x01
+
+/* Формат данных части кадра ('D','S'), биты 1-2 флагов:
+ *   STREAM_FORMAT_RGB - r, g, b по байту
+ *   STREAM_FORMAT_565 - два байта, младший первым: биты 15-11 r, 10-5 g, 4-0 b
+ *   STREAM_FORMAT_444 - два светодиода в трёх байтах: r1 g1, b1 r2, g2 b2 (старший полубайт первым). 
+ *                       При нечётном количестве последний светодиод занимает два байта: r g, b 0
+ *   STREAM_FORMAT_INDEX - байт номера цвета в палитре, загруженной командой 'D','P'. Номер за пределами палитры - чёрный цвет
+ */
+#define STREAM_FORMAT_MASK 0x06
+#define STREAM_FORMAT_RGB 0x00
+#define STREAM_FORMAT_565 0x02
+#define STREAM_FORMAT_444 0x04
+#define STREAM_FORMAT_INDEX 0x06
+
+#define STREAM_PALETTE_MAX 256 // Максимальное количество цветов в палитре
+
+/* Палитра размещается в конце буфера mem, поэтому помещается только при достаточно короткой ленте:
+ * led_num + количество цветов не более MAX_LED_COUNT. Палитра теряется, как только буфер начинают использовать эффекты */
+extern led_rec * stream_palette;
+extern uint16_t stream_palette_size;
+
+#define STREAM_OP_SKIP 0x00
+#define STREAM_OP_RUN 0x40
+#define STREAM_OP_LITERAL 0x80
+#define STREAM_OP_XOR 0xC0
+
+/* Читает из пакета count цветов по 3 байта и записывает их начиная с led */
+void stream_read_raw(led_rec * led, uint16_t count);
+
+/* Кадры, принимаемые по сети, декодируются в буфер приёма stream_back, а по команде завершения кадра копируются в mem.leds
+ * и выводятся на ленту по ближайшему такту таймера. Если до такта завершено несколько кадров, выводится последний.
+ * Буфер приёма находится в конце mem (ниже палитры), если там хватает места на led_num светодиодов,
+ * иначе совпадает с mem.leds - тогда кадр, переданный частями, может быть выведен недособранным.
+ * Буфер приёма всегда хранит последнее принятое состояние, к нему применяются разностные кадры и части кадров */
+extern led_rec * stream_back;
+extern uint8_t stream_pending; // Собранный кадр ожидает вывода
+extern uint8_t stream_fade; // Оставшееся количество тактов плавного перехода к кадру в буфере приёма
+
+/* Размещает буфер приёма, если он ещё не размещён, и копирует в него текущее содержимое mem.leds */
+void stream_begin();
+
+/* Завершает кадр в буфере приёма: он будет выведен по следующему такту */
+void stream_commit();
+
+/* Завершает ключевой кадр ('D','K'): mem.leds плавно переходит к содержимому буфера приёма за frames тактов.
+ * Каждый такт к каждой компоненте добавляется (цель - текущее) / оставшееся количество тактов, так что переход линейный
+ * и не требует третьего буфера. Если цель меняется во время перехода (пришли части следующего кадра), то траектория
+ * плавно поворачивает к новой цели. Без отдельного буфера приёма переход невозможен, и кадр выводится сразу */
+void stream_commit_fade(uint8_t frames);
+
+/* Вызывается по такту таймера, когда stream_pending: выполняет шаг перехода и сбрасывает stream_pending, когда кадр готов.
+ * После вызова содержимое mem.leds нужно вывести на ленту */
+void stream_present();
+
+/* Размер данных count светодиодов в формате format */
+uint16_t stream_data_size(uint8_t format, uint16_t count);
+
+/* Читает из пакета count светодиодов в формате format и записывает их начиная с led */
+void stream_read(uint8_t format, led_rec * led, uint16_t count);
+
+/* Читает из пакета палитру из count цветов. Возвращает 0, если она не помещается в буфере при текущей длине ленты.
+ * Буфер приёма после этого нужно разместить заново вызовом stream_begin() */
+uint8_t stream_palette_load(uint16_t count);
+
+/* Отказывается от палитры и буфера приёма: конец mem будет использован для чего-то другого */
+void stream_release();
+
+/* Читает из пакета команды сжатого кадра (без байта флагов) и применяет их к count светодиодам начиная с led */
+void stream_read_rle(led_rec * led, uint16_t count);
+
+#endif /* STREAM_H_ */
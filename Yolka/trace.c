@@ -0,0 +1,39 @@
+﻿/*
+ * trace.c
+ *
+ * Журнал событий основного цикла для поиска задержек, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include "trace.h"
+#include "wifiman.h"
+
+#ifdef TRACE_BUFFER
+
+static TraceRec trace_buf[TRACE_SIZE];
+static uint8_t trace_pos; // Место для следующей записи
+static uint8_t trace_count;
+
+void trace(uint8_t ev, uint8_t arg) {
+  TraceRec * r = &trace_buf[trace_pos];
+  r->t = wifiman_time();
+  r->ev = ev;
+  r->arg = arg;
+  trace_pos = (trace_pos + 1) & (TRACE_SIZE - 1);
+  if (trace_count < TRACE_SIZE) trace_count++;
+}
+
+uint8_t trace_dump(TraceRec * buf) {
+  uint8_t n = trace_count;
+  uint8_t p = (trace_pos - n) & (TRACE_SIZE - 1);
+  for (uint8_t i = n; i; i--) {
+    *(buf++) = trace_buf[p];
+    p = (p + 1) & (TRACE_SIZE - 1);
+  }
+  trace_count = 0;
+  return n;
+}
+
+#endif
@@ -0,0 +1,52 @@
+﻿/*
+ * trace.h
+ *
+ * Журнал событий основного цикла для поиска задержек, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <avr/io.h>
+
+/* Если определено TRACE_BUFFER, то в кольцевой буфер на TRACE_SIZE записей пишутся события с отметкой времени
+ * wifiman_time() (такты таймера 1 по 16 мкс, переполняется примерно раз в секунду). Команда 'Q','T' выдаёт записи
+ * от старой к новой и очищает буфер. Буфер занимает TRACE_SIZE * 4 байт ОЗУ, поэтому по умолчанию выключен.
+ * Без TRACE_BUFFER макрос TRACE ничего не делает.
+ */
+//#define TRACE_BUFFER
+
+#define TRACE_SIZE 16 // Количество записей, степень двойки; не более 16, чтобы журнал помещался в один ответ
+
+// События и их аргументы
+#define TRACE_FRAME 1 // Такт таймера: начало кадра
+#define TRACE_RENDER 2 // Начало отрисовки зоны; номер эффекта
+#define TRACE_RENDER_END 3 // Конец отрисовки зоны; номер зоны
+#define TRACE_OUT 4 // Начало вывода на ленту
+#define TRACE_OUT_END 5 // Конец вывода на ленту
+#define TRACE_PACKET 6 // Начало обработки команды; первый байт команды
+#define TRACE_WIFI 7 // Смена состояния менеджера вай-фая; новое состояние
+#define TRACE_EEPROM 8 // Запись в EEPROM; младший байт адреса
+
+typedef struct {
+  uint16_t t;
+  uint8_t ev;
+  uint8_t arg;
+} TraceRec;
+
+#ifdef TRACE_BUFFER
+  #define TRACE(ev, arg) trace(ev, arg)
+
+  /* Добавляет запись, вытесняя самую старую */
+  void trace(uint8_t ev, uint8_t arg);
+
+  /* Копирует в buf записи от старой к новой и очищает буфер. Возвращает количество записей */
+  uint8_t trace_dump(TraceRec * buf);
+#else
+  #define TRACE(ev, arg)
+#endif
+
+#endif /* TRACE_H_ */
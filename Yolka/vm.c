@@ -0,0 +1,209 @@
+﻿/*
+ * vm.c
+ *
+ * Виртуальная машина для эффектов, загружаемых в EEPROM по сети, проект "Ёлка"
+ *
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "vm.h"
+#include "eeprom.h"
+#include "effects.h"
+#include "Yolka.h"
+#include "zones.h"
+
+// Описание операций для проверки: биты 0-1 - количество байт операндов, 2-3 - снимаемых со стека значений,
+// 4-5 - помещаемых на стек, бит 7 - операция вывода цвета
+#define OPI(operands, pops, pushes) ((operands) | ((pops) << 2) | ((pushes) << 4))
+#define OPI_OUT 0x80
+
+static const PROGMEM uint8_t vm_op_info[VM_OPS_COUNT] = {
+  OPI(0, 0, 0), // VM_END
+  OPI(1, 0, 1), // VM_PUSH8
+  OPI(2, 0, 1), // VM_PUSH16
+  OPI(0, 0, 1), // VM_LDI
+  OPI(0, 0, 1), // VM_LDN
+  OPI(0, 0, 1), // VM_LDT
+  OPI(1, 0, 1), // VM_LDV
+  OPI(1, 1, 0), // VM_STV
+  OPI(0, 2, 1), // VM_ADD
+  OPI(0, 2, 1), // VM_SUB
+  OPI(0, 2, 1), // VM_MUL
+  OPI(0, 2, 1), // VM_MULF
+  OPI(1, 1, 1), // VM_SHR
+  OPI(1, 1, 1), // VM_SHL
+  OPI(0, 2, 1), // VM_AND
+  OPI(0, 2, 1), // VM_OR
+  OPI(0, 2, 1), // VM_XOR
+  OPI(0, 1, 1), // VM_NEG
+  OPI(0, 1, 2), // VM_DUP
+  OPI(0, 2, 2), // VM_SWAP
+  OPI(0, 1, 0), // VM_DROP
+  OPI(0, 2, 1), // VM_MIN
+  OPI(0, 2, 1), // VM_MAX
+  OPI(0, 2, 1), // VM_LT
+  OPI(0, 3, 1), // VM_SEL
+  OPI(0, 1, 1), // VM_SIN
+  OPI(0, 0, 1), // VM_RND
+  OPI(0, 1, 1), // VM_RNDN
+  OPI(0, 1, 1), // VM_CLAMP
+  OPI(0, 2, 0) | OPI_OUT, // VM_HB
+  OPI(0, 3, 0) | OPI_OUT, // VM_HSB
+  OPI(0, 2, 0) | OPI_OUT, // VM_HBOVER
+  OPI(0, 3, 0) | OPI_OUT, // VM_RGB
+};
+
+uint8_t vm_check(const uint8_t * code, uint8_t len, uint8_t pixel) {
+  uint8_t depth = 0;
+  uint8_t pos = 0;
+  while (pos < len) {
+    uint8_t op = code[pos++];
+    if ((op == VM_END) || (op >= VM_OPS_COUNT)) return 0;
+    uint8_t info = pgm_read_byte(&vm_op_info[op]);
+    if ((info & OPI_OUT) && !pixel) return 0;
+    uint8_t operands = info & 3;
+    if ((len - pos) < operands) return 0;
+    if (((op == VM_LDV) || (op == VM_STV)) && (code[pos] >= VM_VARS)) return 0;
+    if (((op == VM_SHR) || (op == VM_SHL)) && (code[pos] > 15)) return 0;
+    pos += operands;
+    uint8_t pops = (info >> 2) & 3;
+    if (depth < pops) return 0;
+    depth = depth - pops + ((info >> 4) & 3);
+    if (depth > VM_STACK_SIZE) return 0;
+  }
+  return 1;
+}
+
+/* Шитый код: переход к обработчику очередной операции выполняется косвенным переходом по таблице адресов во флеш-памяти,
+ * без возврата в общий цикл. Вершина стека хранится в отдельной переменной (регистрах), остальное - в массиве stack */
+void vm_exec(const uint8_t * code, VmContext * ctx, uint16_t count, led_rec * led) {
+  static const PROGMEM void * const ops[VM_OPS_COUNT] = {
+    &&op_end, &&op_push8, &&op_push16, &&op_ldi, &&op_ldn, &&op_ldt, &&op_ldv, &&op_stv,
+    &&op_add, &&op_sub, &&op_mul, &&op_mulf, &&op_shr, &&op_shl, &&op_and, &&op_or,
+    &&op_xor, &&op_neg, &&op_dup, &&op_swap, &&op_drop, &&op_min, &&op_max, &&op_lt,
+    &&op_sel, &&op_sin, &&op_rnd, &&op_rndn, &&op_clamp, &&op_hb, &&op_hsb, &&op_hbover,
+    &&op_rgb
+  };
+  int16_t stack[VM_STACK_SIZE + 1];
+  int16_t * sp = stack;
+  int16_t tos = 0;
+  int16_t a;
+  uint16_t i = 0;
+  const uint8_t * pc = code;
+  if (!count) return;
+
+  #define NEXT goto *pgm_read_ptr(&ops[*(pc++)])
+  #define PUSH(v) do { *(sp++) = tos; tos = (v); } while (0)
+  #define POP() (*(--sp))
+
+  NEXT;
+
+  op_end:
+    if (!(--count)) return;
+    i++;
+    led++;
+    pc = code;
+    sp = stack;
+    NEXT;
+  op_push8: PUSH(*(pc++)); NEXT;
+  op_push16: a = pc[0] | (pc[1] << 8); pc += 2; PUSH(a); NEXT;
+  op_ldi: PUSH(i); NEXT;
+  op_ldn: PUSH(ctx->n); NEXT;
+  op_ldt: PUSH(ctx->t); NEXT;
+  op_ldv: PUSH(ctx->v[*(pc++)]); NEXT;
+  op_stv: ctx->v[*(pc++)] = tos; tos = POP(); NEXT;
+  op_add: tos = POP() + tos; NEXT;
+  op_sub: tos = POP() - tos; NEXT;
+  op_mul: tos = POP() * tos; NEXT;
+  op_mulf: tos = ((int32_t)POP() * tos) >> 8; NEXT;
+  op_shr: tos = (uint16_t)tos >> *(pc++); NEXT;
+  op_shl: tos = tos << *(pc++); NEXT;
+  op_and: tos = POP() & tos; NEXT;
+  op_or: tos = POP() | tos; NEXT;
+  op_xor: tos = POP() ^ tos; NEXT;
+  op_neg: tos = -tos; NEXT;
+  op_dup: *(sp++) = tos; NEXT;
+  op_swap: a = sp[-1]; sp[-1] = tos; tos = a; NEXT;
+  op_drop: tos = POP(); NEXT;
+  op_min: a = POP(); if (a < tos) tos = a; NEXT;
+  op_max: a = POP(); if (a > tos) tos = a; NEXT;
+  op_lt: a = POP(); tos = (a < tos) ? 1 : 0; NEXT;
+  op_sel: a = POP(); tos = POP() ? a : tos; NEXT;
+  op_sin: tos = sin_t(tos, 256); NEXT;
+  op_rnd: PUSH(random16()); NEXT;
+  op_rndn: tos = randomw(tos); NEXT;
+  op_clamp: if (tos < 0) tos = 0; else if (tos > 255) tos = 255; NEXT;
+  op_hb: a = POP(); hb(a, tos, led); tos = POP(); NEXT;
+  op_hsb: a = POP(); hsb(POP(), a, tos, led); tos = POP(); NEXT;
+  op_hbover: a = POP(); hbover(a, tos, led); tos = POP(); NEXT;
+  op_rgb:
+    led->b = tos;
+    led->g = POP();
+    led->r = POP();
+    tos = POP();
+    NEXT;
+
+  #undef NEXT
+  #undef PUSH
+  #undef POP
+}
+
+typedef struct {
+  VmContext ctx;
+  uint8_t lf; // Длина покадровой программы, или 0xFF, если слот пуст
+  uint8_t code[VM_CODE_SIZE + 2]; // Обе программы, каждая завершается VM_END
+} VmState;
+EFFECT_STATE_CHECK(VmState);
+
+/* Загружает программу из слота в состояние эффекта. Возвращает 0, если слот пуст или программа испорчена */
+static uint8_t vm_load(VmState * s, uint8_t slot) {
+  uint16_t ee = EE_VM_BASE + slot * VM_SLOT_SIZE;
+  uint8_t lf = eeprom_read(ee++, 0xFF);
+  uint8_t lp = eeprom_read(ee++, 0);
+  if ((lf > VM_CODE_SIZE) || !lp || (lp > (VM_CODE_SIZE - lf))) return 0;
+  uint8_t * p = s->code;
+  for (uint8_t i = lf; i; i--) *(p++) = eeprom_read(ee++, 0xFF);
+  *(p++) = VM_END;
+  for (uint8_t i = lp; i; i--) *(p++) = eeprom_read(ee++, 0xFF);
+  *p = VM_END;
+  // Содержимое EEPROM могло быть испорчено, поэтому проверяем ещё раз
+  if (!vm_check(s->code, lf, 0) || !vm_check(s->code + lf + 1, lp, 1)) return 0;
+  s->lf = lf;
+  return 1;
+}
+
+static void vm_effect(EffectZone * z, uint8_t slot) {
+  VmState * s = EFFECT_STATE(z, VmState);
+  if (z->init) {
+    if (!vm_load(s, slot)) {
+      s->lf = 0xFF;
+      zone_skip(z);
+      return;
+    }
+    s->ctx.t = 0;
+    s->ctx.n = z->num;
+    for (uint8_t i = 0; i < VM_VARS; i++) s->ctx.v[i] = 0;
+  }
+  if (s->lf == 0xFF) return;
+  if (s->lf) vm_exec(s->code, &s->ctx, 1, 0);
+  vm_exec(s->code + s->lf + 1, &s->ctx, z->num, z->leds);
+  s->ctx.t++;
+}
+
+void vm_effect_0(EffectZone * z) {
+  vm_effect(z, 0);
+}
+
+void vm_effect_1(EffectZone * z) {
+  vm_effect(z, 1);
+}
+
+void vm_effect_2(EffectZone * z) {
+  vm_effect(z, 2);
+}
+
+void vm_effect_3(EffectZone * z) {
+  vm_effect(z, 3);
+}
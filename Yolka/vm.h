@@ -0,0 +1,91 @@
+﻿/*
+ * vm.h
+ *
+ * Виртуальная машина для эффектов, загружаемых в EEPROM по сети, проект "Ёлка"
+ *
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */
+
+
+#ifndef VM_H_
+#define VM_H_
+
+#include <avr/io.h>
+#include "ws2812.h"
+#include "effects.h"
+
+/* Программа эффекта состоит из двух частей: покадровой (выполняется один раз перед каждым кадром)
+ * и пиксельной (выполняется для каждого светодиода, результат - цвет светодиода).
+ * Стековая машина, значения 16 битные со знаком. Для дробных величин принята фиксированная точка 8.8 (256 соответствует единице).
+ * Ветвлений нет, поэтому глубина стека проверяется при загрузке и во время выполнения не контролируется.
+ *
+ * Слот в EEPROM: lf, lp, <код покадровой программы (lf байт)>, <код пиксельной программы (lp байт)>
+ * lp = 0 или 0xFF - слот пуст. Завершающий VM_END в EEPROM не хранится.
+ */
+
+#define EE_VM_BASE 512 // Начало области программ в EEPROM (сразу за EE_ST_PWD)
+#define VM_SLOTS 4 // Количество слотов для программ
+#define VM_SLOT_SIZE 64 // Размер слота
+#define VM_CODE_SIZE (VM_SLOT_SIZE - 2) // Максимальный суммарный размер кода обеих программ
+
+#define VM_STACK_SIZE 8 // Максимальная глубина стека
+#define VM_VARS 8 // Количество переменных, сохраняющих значения между кадрами
+
+// Коды операций. В скобках: операнды в коде; снимаемые со стека -> помещаемые на стек
+#define VM_END 0x00 // Конец программы (в EEPROM не хранится)
+#define VM_PUSH8 0x01 // (u8) -> u8
+#define VM_PUSH16 0x02 // (lo, hi) -> v
+#define VM_LDI 0x03 // -> номер светодиода
+#define VM_LDN 0x04 // -> количество светодиодов в зоне
+#define VM_LDT 0x05 // -> номер кадра
+#define VM_LDV 0x06 // (k) -> переменная k
+#define VM_STV 0x07 // (k) a -> ; сохраняет в переменную k
+#define VM_ADD 0x08 // a b -> a + b
+#define VM_SUB 0x09 // a b -> a - b
+#define VM_MUL 0x0A // a b -> a * b
+#define VM_MULF 0x0B // a b -> (a * b) >> 8
+#define VM_SHR 0x0C // (k) a -> a >> k (без знака)
+#define VM_SHL 0x0D // (k) a -> a << k
+#define VM_AND 0x0E // a b -> a & b
+#define VM_OR 0x0F // a b -> a | b
+#define VM_XOR 0x10 // a b -> a ^ b
+#define VM_NEG 0x11 // a -> -a
+#define VM_DUP 0x12 // a -> a a
+#define VM_SWAP 0x13 // a b -> b a
+#define VM_DROP 0x14 // a ->
+#define VM_MIN 0x15 // a b -> min(a, b)
+#define VM_MAX 0x16 // a b -> max(a, b)
+#define VM_LT 0x17 // a b -> (a < b) ? 1 : 0
+#define VM_SEL 0x18 // c a b -> c ? a : b
+#define VM_SIN 0x19 // p -> sin(2 * Pi * p / 65536) * 256
+#define VM_RND 0x1A // -> случайное число
+#define VM_RNDN 0x1B // n -> случайное число от 0 до n - 1
+#define VM_CLAMP 0x1C // a -> a, ограниченное пределами 0..255
+#define VM_HB 0x1D // h b -> ; цвет светодиода по оттенку и яркости (только в пиксельной программе)
+#define VM_HSB 0x1E // h s b -> ; цвет по оттенку, насыщенности и яркости (только в пиксельной программе)
+#define VM_HBOVER 0x1F // h b -> ; цвет по оттенку и яркости с пересветом 0..511 (только в пиксельной программе)
+#define VM_RGB 0x20 // r g b -> ; цвет по компонентам (только в пиксельной программе)
+
+#define VM_OPS_COUNT 0x21
+
+typedef struct {
+  uint16_t t; // Номер кадра
+  uint16_t n; // Количество светодиодов в зоне
+  int16_t v[VM_VARS]; // Переменные
+} VmContext;
+
+/* Проверяет программу длиной len (без завершающего VM_END). pixel - признак пиксельной программы
+ * Возвращает 1, если программа корректна */
+uint8_t vm_check(const uint8_t * code, uint8_t len, uint8_t pixel);
+
+/* Выполняет программу, завершающуюся VM_END, count раз: для светодиодов с номерами от 0 до count - 1,
+ * записывая результат последовательно начиная с led. Для покадровой программы led = 0, count = 1 */
+void vm_exec(const uint8_t * code, VmContext * ctx, uint16_t count, led_rec * led);
+
+// Эффекты, выполняющие программы из соответствующих слотов
+void vm_effect_0(EffectZone * z);
+void vm_effect_1(EffectZone * z);
+void vm_effect_2(EffectZone * z);
+void vm_effect_3(EffectZone * z);
+
+#endif /* VM_H_ */
@@ -9,7 +9,9 @@
 #include "wifiman.h"
 #include "eeprom.h"
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include "tools.h"
+#include "trace.h"
 
 const PROGMEM uint8_t str_default_ap_ssid[] = "WIFI_YOLKA";
 const PROGMEM uint8_t str_default_ap_pwd[] = "0123456789";
@@ -22,17 +24,23 @@ uint8_t in_queue[IN_QUEUE_SIZE];
 volatile uint8_t in_queue_read_pos;
 volatile uint8_t in_queue_write_pos;
 
-uint8_t out_queue[IN_QUEUE_SIZE];
+uint8_t out_queue[OUT_QUEUE_SIZE];
 volatile uint8_t out_queue_read_pos;
 volatile uint8_t out_queue_write_pos;
 
 uint8_t parser_state;
 
+WifimanStats wifiman_stats;
+uint16_t cts_since; // Время приостановки приёма wifiman_suspend_cts()
+
 volatile uint8_t next_frame;
+static uint8_t frame_late; // Опоздание к текущему кадру уже учтено в wifiman_stats.overruns
+volatile uint16_t frame_counter; // Счётчик прерываний таймера, для отсчёта времени
 volatile uint16_t wifiman_timeout; // Таймаут на выполнение команды
 volatile uint8_t wifiman_delay; // Задержка до перехода в следующее состояние
 
 uint16_t packet_len;
+static uint8_t packet_skipping; // Идёт пропуск непрочитанного пакета
 
 uint8_t wifiman_state;
 uint8_t busys_cnt;
@@ -48,6 +56,7 @@ struct {
 
 ISR(TIMER1_COMPA_vect) {
   next_frame = 1;
+  frame_counter++;
   uint16_t to = wifiman_timeout;
   if (to) wifiman_timeout = to - 1;
   uint8_t d = wifiman_delay;
@@ -77,10 +86,12 @@ void wifiman_init() {
   UCSR0C = (1 << UCSZ00) | (1 << UCSZ01);
   
   TCCR1A = 0;
-  OCR1A = 1249; // прервыание 50 раз в секунду
+  OCR1A = TIMER_TICKS_PER_FRAME - 1; // прервыание 50 раз в секунду
   TIMSK1 = (1 << OCIE1A);
   TCCR1B = (1 << WGM12) | (1 << CS12); // прескалер 1 к 256 (62500 тактов в секунду)
   TCNT1 = 0;
+  
+  set_sleep_mode(SLEEP_MODE_IDLE); // Таймер и UART продолжают работать, любое их прерывание будит процессор
 }
 
 ISR(USART_UDRE_vect) {
@@ -99,7 +110,9 @@ ISR(USART_RX_vect) {
   in_queue[wp] = d;
   wp = (wp + 1) & (IN_QUEUE_SIZE - 1);
   in_queue_write_pos = wp;
-  if (((wp - in_queue_read_pos) & (IN_QUEUE_SIZE - 1)) >= IN_QUEUE_OFF_THRESHOLD) {
+  uint8_t fill = (wp - in_queue_read_pos) & (IN_QUEUE_SIZE - 1);
+  if (fill > wifiman_stats.in_queue_max) wifiman_stats.in_queue_max = fill;
+  if (fill >= IN_QUEUE_OFF_THRESHOLD) {
     suspend_rx();
   }
 }
@@ -112,6 +125,8 @@ static void send(uint8_t b) {
   }
   out_queue[wp] = b; // Байтик помещается в очередь
   cli(); // Прерывания блокируются, чтобы исключить ситуацию когда out_queue_write_pos обновлён после чего происходит прерывание, после чего прерывание разрешается при уже пустой очереди
+  uint8_t fill = (nwp - out_queue_read_pos) & (OUT_QUEUE_SIZE - 1);
+  if (fill > wifiman_stats.out_queue_max) wifiman_stats.out_queue_max = fill;
   out_queue_write_pos = nwp;
   UCSR0B |= (1 << UDRIE0); // Безусловное разрешение прерывания в конце
   sei();
@@ -185,6 +200,7 @@ static const PROGMEM uint8_t str_quot_comma_quot[] = "\",\"";
 static const PROGMEM uint8_t str_quot_crlf[] = "\"\r\n";
 
 static void to_state(uint8_t new_state, uint16_t timeout) {
+  TRACE(TRACE_WIFI, new_state);
   wifiman_state = new_state;
   wifiman_timeout = timeout;
 }
@@ -246,11 +262,16 @@ static inline uint8_t check(uint8_t b) {
 }  
 
 static uint8_t parse() {
+  if (packet_len && !packet_skipping) { // Пакет учитывается один раз, хотя пропуск может растянуться на много вызовов
+    packet_skipping = 1;
+    wifiman_stats.dropped++;
+  }
   while (packet_len) { // Если у нас на очереди непрочитанный пакет, то игнорируем его
     if (in_queue_read_pos == in_queue_write_pos) return 0; // Если нет данных в буфере - выходим
     read();
     packet_len--;
   }
+  packet_skipping = 0;
   if (in_queue_read_pos == in_queue_write_pos) {
     return 0;
   }
@@ -368,6 +389,7 @@ uint8_t wifiman_pull() {
   if (parsed == PARSED_BUSY) {
     busys_cnt++;
     if (busys_cnt >= 3) {
+      wifiman_stats.busy_resets++;
       if (wifiman_state != WIFIMAN_INIT_REQUIRED) {
         send_pgmz(&str_rst); // Не помогает, один фиг. Обойти баг помогла замена CIPSEND на CIPSENDBUF
       }
@@ -557,6 +579,7 @@ uint8_t wifiman_pull() {
         wifiman_state = WIFIMAN_READY;
         wifiman_timeout = 0;
         wifiman_delay = 0;
+        wifiman_stats.send_errors++;
         return EVENT_SENT_ERROR;
       }
       break;
@@ -569,15 +592,37 @@ uint8_t wifiman_pull() {
   return 0;
 }
 
-/* В цикле вызывает wifiman_pull() пока таймер не переполнится.
+/* Если делать нечего - очередь приёма пуста и такт таймера ещё не наступил, - останавливает процессор до ближайшего прерывания
+ * (приём или передача по UART, таймер). Всё, что может дать работу wifiman_pull(), происходит в этих прерываниях, поэтому задержки не добавляется.
+ * Проверка выполняется при запрещённых прерываниях: sei() разрешает их только после следующей инструкции, 
+ * так что прерывание, пришедшее после проверки, не будет пропущено, а разбудит процессор */
+static void idle() {
+  cli();
+  if (!next_frame && (in_queue_read_pos == in_queue_write_pos)) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+}
+
+/* В цикле вызывает wifiman_pull() пока таймер не переполнится, в перерывах останавливая процессор.
  * Если произошло событие, то немедленно возвращает код события */
 
 uint8_t wifiman_wait_frame() {
+  // wifiman_wait_frame вызывается повторно после каждого пакета, поэтому опоздание считается один раз на кадр
+  if (next_frame && !frame_late) {
+    frame_late = 1;
+    wifiman_stats.overruns++;
+  }
   do {
     uint8_t r = wifiman_pull();
     if (r) return r;
+    idle();
   } while (!next_frame);
   next_frame = 0;
+  frame_late = 0;
   return 0;
 }
 
@@ -594,6 +639,21 @@ uint8_t wifiman_read() {
   return read();
 }
 
+uint16_t wifiman_packet_limit(uint16_t len) {
+  if (len > packet_len) len = packet_len;
+  uint16_t rest = packet_len - len;
+  packet_len = len;
+  return rest;
+}
+
+void wifiman_packet_unlimit(uint16_t rest) {
+  while (packet_len) {
+    packet_len--;
+    read();
+  }
+  packet_len = rest;
+}
+
 uint8_t wifiman_ready() {
   return wifiman_state == WIFIMAN_READY;
 }
@@ -633,6 +693,7 @@ void wifiman_request_reinit() {
 uint8_t wifiman_suspend_cts() {
   uint8_t r = !(PORT(CTS_PORT) & CTS);
   suspend_rx();
+  if (r) cts_since = wifiman_time();
   return r;
 }
 
@@ -646,7 +707,11 @@ void wifiman_close(uint8_t linkid) {
 }
 
 void wifiman_restore_cts(uint8_t prev) {
-  if (prev) resume_rx();
+  if (prev) {
+    uint16_t t = wifiman_time() - cts_since;
+    if (t > wifiman_stats.cts_max) wifiman_stats.cts_max = t;
+    resume_rx();
+  }
 }
 
 void wifiman_wait_outbuf() {
@@ -655,5 +720,25 @@ void wifiman_wait_outbuf() {
   return;
 }
 
+uint16_t wifiman_time() {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t t = TCNT1;
+  uint16_t f = frame_counter;
+  if ((TIFR1 & (1 << OCF1A)) && (t < (TIMER_TICKS_PER_FRAME / 2))) f++; // Таймер уже сбросился, но прерывание ещё не обработано
+  SREG = oldSREG;
+  return f * TIMER_TICKS_PER_FRAME + t;
+}
+
+uint32_t wifiman_time_long() {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t t = TCNT1;
+  uint16_t f = frame_counter;
+  if ((TIFR1 & (1 << OCF1A)) && (t < (TIMER_TICKS_PER_FRAME / 2))) f++;
+  SREG = oldSREG;
+  return (uint32_t)f * TIMER_TICKS_PER_FRAME + t;
+}
+
 
 
@@ -87,6 +87,9 @@
 
 #define DELAY_ONE_SECOND 50
 
+#define TIMER_TICKS_PER_FRAME 1250 // Тактов таймера 1 за кадр (1/50 секунды)
+#define TIMER_TICK_CYCLES 256 // Тактов процессора за один такт таймера 1
+
 // Позиции в EEPROM
 #define EE_PORT 60 
 #define EE_AP_CHAN 63
@@ -101,6 +104,19 @@
 #define EE_ST_SSID 384
 #define EE_ST_PWD 448
 
+// Счётчики работы с ESP8266. Время - в тактах таймера 1 (16 мкс)
+typedef struct {
+  uint16_t overruns; // Кадры, к началу ожидания которых таймер уже сработал (обработка предыдущего кадра не уложилась)
+  uint16_t cts_max; // Наибольшее время, на которое приём приостанавливался wifiman_suspend_cts()
+  uint8_t in_queue_max; // Наибольшее заполнение входной очереди
+  uint8_t out_queue_max; // Наибольшее заполнение выходной очереди
+  uint16_t dropped; // Пакеты, данные которых были пропущены непрочитанными
+  uint16_t busy_resets; // Переинициализации из-за повторяющихся ответов busy
+  uint16_t send_errors; // Неудачные отправки
+} WifimanStats;
+
+extern WifimanStats wifiman_stats;
+
 extern const PROGMEM uint8_t str_default_ap_ssid[];
 extern const PROGMEM uint8_t str_default_ap_pwd[];
 extern const PROGMEM uint8_t str_default_ap_ip[];
@@ -129,6 +145,13 @@ uint16_t wifiman_packet_len();
 /* Читает очередной байт из пакета. Если достигнут конец пакета, будет возвращать нули */
 uint8_t wifiman_read();
 
+/* Ограничивает текущий пакет следующими len байтами: за ними wifiman_packet_len() вернёт 0, а wifiman_read() - нули.
+ * Возвращает количество байт пакета за пределами ограничения, которое нужно передать в wifiman_packet_unlimit() */
+uint16_t wifiman_packet_limit(uint16_t len);
+
+/* Пропускает непрочитанные байты ограниченной части пакета и делает доступными остальные rest байт */
+void wifiman_packet_unlimit(uint16_t rest);
+
 /* Признак готовности (отправке очередного пакета, закрытию соединения, запрос на реинициализацию) */
 uint8_t wifiman_ready();
 
@@ -153,4 +176,12 @@ void wifiman_restore_cts(uint8_t prev);
 /* Ожидает опустошения выходного буфера */
 void wifiman_wait_outbuf();
 
+/* Возвращает текущее время в тактах таймера 1 (по 16 мкс). Значение циклически переполняется примерно раз в секунду,
+ * поэтому годится для измерения промежутков не длиннее секунды: разность двух значений даёт прошедшее время */
+uint16_t wifiman_time();
+
+/* То же, что wifiman_time, но 32-разрядное: переполняется вместе со счётчиком кадров (примерно раз в 22 минуты).
+ * Для промежутков, длина которых заранее не ограничена */
+uint32_t wifiman_time_long();
+
 #endif /* WIFIMAN_H_ */
\ No newline at end of file
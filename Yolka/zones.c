@@ -0,0 +1,139 @@
+﻿/*
+ * zones.c
+ *
+ * Зоны: независимые эффекты на разных участках ленты, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "zones.h"
+#include "eeprom.h"
+#include "wifiman.h"
+#include "Yolka.h"
+#include "cache.h"
+#include "stream.h"
+#include "trace.h"
+
+Zone zones[MAX_ZONES];
+uint8_t zones_count; // 0 - описание зон не загружено
+
+static uint8_t zones_rr; // С какой зоны начинать отрисовку в следующем кадре
+static uint8_t zones_effect; // Текущий эффект зон со сменой эффектов
+
+// Состояние первой зоны. Состояния остальных хранятся в конце mem, за данными светодиодов
+static uint8_t zone0_state[EFFECT_STATE_SIZE];
+
+static void zone_set(uint8_t n, uint16_t start, uint16_t len, uint8_t effect, uint8_t speed) {
+  Zone * zn = &zones[n];
+  zn->z.leds = &mem.leds[start];
+  zn->z.num = len;
+  zn->z.st = n ? ((uint8_t *)&mem + sizeof(mem) - n * EFFECT_STATE_SIZE) : zone0_state;
+  zn->effect = effect;
+  zn->speed = speed ? speed : 1;
+  zn->cost = 0;
+}
+
+static void zones_load() {
+  uint8_t cnt = ZONES_FIXED ? 0 : eeprom_read(EE_ZONES, 0);
+  if (cnt > MAX_ZONES) cnt = 0;
+  uint16_t ee = EE_ZONES + 1;
+  uint16_t tail = sizeof(mem) - led_num * 3; // Свободное место в конце mem
+  uint8_t n = 0;
+  while (cnt--) {
+    uint16_t start = eeprom_read_uint16(ee, 0xFFFF);
+    uint16_t len = eeprom_read_uint16(ee + 2, 0);
+    uint8_t effect = eeprom_read(ee + 4, ZONE_EFFECT_ROTATION);
+    uint8_t speed = eeprom_read(ee + 5, 1);
+    ee += ZONE_REC_SIZE;
+    if ((start >= led_num) || !len) continue;
+    if ((effect != ZONE_EFFECT_ROTATION) && (effect >= num_effects)) continue;
+    if (len > (led_num - start)) len = led_num - start;
+    if (n) {
+      if (tail < EFFECT_STATE_SIZE) break; // Для состояния эффекта не осталось места
+      tail -= EFFECT_STATE_SIZE;
+    }
+    zone_set(n++, start, len, effect, speed);
+  }
+  if (!n) {
+    zone_set(n++, 0, led_num, ZONE_EFFECT_ROTATION, 1);
+  }
+  zones_count = n;
+  zones_rr = 0;
+  // Между светодиодами и состояниями зон - таблицы
+  stream_release(); // Конец буфера переходит к состояниям зон
+  cache_setup((uint8_t *)&mem.leds[led_num], (uint8_t *)&mem + sizeof(mem) - (n - 1) * EFFECT_STATE_SIZE);
+}
+
+void zones_single(uint8_t ef) {
+  zone_set(0, 0, led_num, ef, 1);
+  zones_count = 1;
+  zones_rr = 0;
+  stream_release();
+  cache_setup((uint8_t *)&mem.leds[led_num], (uint8_t *)&mem + sizeof(mem));
+  clear(mem.leds, led_num);
+  zones[0].z.init = 1;
+  zones[0].wait = 0;
+}
+
+void zones_invalidate() {
+  zones_count = 0;
+  cache_release();
+}
+
+void zones_start(uint8_t ef) {
+  zones_effect = ef;
+  uint8_t all = 0;
+  if (!zones_count) {
+    zones_load();
+    clear(mem.leds, led_num);
+    all = 1;
+  }
+  for (uint8_t n = 0; n < zones_count; n++) {
+    Zone * zn = &zones[n];
+    if (all || (zn->effect == ZONE_EFFECT_ROTATION)) {
+      zn->z.init = 1;
+      zn->wait = 0;
+    }
+  }
+}
+
+void zones_render() {
+  if (!zones_count) zones_start(zones_effect); // Описание зон сброшено (zones_invalidate): строим зоны заново, не прерывая показ
+  // Время на отрисовку: кадр (при пониженной частоте - frame_divider тактов таймера), за вычетом вывода на ленту 
+  // (30 мкс, т.е. 15/8 такта таймера на светодиод) и запаса
+  int16_t budget = frame_divider * TIMER_TICKS_PER_FRAME - ZONES_FRAME_RESERVE - ((led_num * 15) >> 3);
+  uint8_t rendered = 0;
+  uint8_t deferred = 0xFF;
+  uint8_t n = zones_rr;
+  for (uint8_t k = zones_count; k; k--) {
+    Zone * zn = &zones[n];
+    if (zn->wait) {
+      zn->wait--;
+    } else if (rendered && ((int16_t)zn->cost > budget)) {
+      // Не успеваем: зона остаётся в очереди и отрисуется первой в следующем кадре
+      if (deferred == 0xFF) deferred = n;
+    } else {
+      uint8_t ef = (zn->effect == ZONE_EFFECT_ROTATION) ? zones_effect : zn->effect;
+      void(*fx)(EffectZone * z) = pgm_read_ptr(&effects_list[ef].effect);
+      TRACE(TRACE_RENDER, ef);
+      uint16_t t = wifiman_time();
+      fx(&zn->z);
+      t = wifiman_time() - t;
+      TRACE(TRACE_RENDER_END, n);
+      zn->cost = zn->z.init ? t : (zn->cost - (zn->cost >> 2) + ((t + 3) >> 2));
+      budget -= t;
+      zn->z.init = 0;
+      zn->wait = zn->speed - 1;
+      rendered = 1;
+    }
+    if (++n >= zones_count) n = 0;
+  }
+  if (deferred != 0xFF) zones_rr = deferred;
+}
+
+void zone_skip(EffectZone * z) {
+  clear(z->leds, z->num);
+  if (((Zone *)z)->effect == ZONE_EFFECT_ROTATION) effect_countdown = 0;
+}
@@ -0,0 +1,67 @@
+﻿/*
+ * zones.h
+ *
+ * Зоны: независимые эффекты на разных участках ленты, проект "Ёлка"
+ * 
+ * Author: Погребняк Дмитрий, г. Самара, 2015
+ */ 
+
+
+#ifndef ZONES_H_
+#define ZONES_H_
+
+#include <avr/io.h>
+#include "effects.h"
+
+/* Описание зон в EEPROM: count, затем count записей по ZONE_REC_SIZE байт:
+ *   start_lo, start_hi - первый светодиод зоны
+ *   len_lo, len_hi - количество светодиодов в зоне (обрезается по led_num)
+ *   effect - номер эффекта из effects_list, либо ZONE_EFFECT_ROTATION - эффекты в зоне сменяются по таймеру, как на всей ленте
+ *   speed - эффект отрисовывается раз в speed кадров
+ * Зоны могут перекрываться, в этом случае в общей части видна зона, описанная позже.
+ * Если зон не задано (или ни одна не подходит под текущее количество светодиодов), то вся лента - одна зона со сменой эффектов.
+ */
+#define EE_ZONES 768 // Сразу за программами виртуальной машины (EE_VM_BASE + VM_SLOTS * VM_SLOT_SIZE)
+#ifdef FIXED_LED_COUNT
+  #define MAX_ZONES 1
+  #define ZONES_FIXED 1 // Описание зон из EEPROM не используется: вся лента - одна зона (эффекты рассчитывают на ZONE_NUM)
+#else
+  #define MAX_ZONES 4
+  #define ZONES_FIXED 0
+#endif
+#define ZONE_REC_SIZE 6
+#define ZONE_EFFECT_ROTATION 0xFF
+
+/* Запас времени кадра (в тактах таймера) на обработку сетевых пакетов и прочие операции между кадрами */
+#define ZONES_FRAME_RESERVE 156
+
+typedef struct {
+  EffectZone z; // Должно быть первым полем: zone_skip получает указатель на него
+  uint8_t effect; // Номер эффекта или ZONE_EFFECT_ROTATION
+  uint8_t speed; // Отрисовка раз в speed кадров
+  uint8_t wait; // Сколько кадров осталось до следующей отрисовки
+  uint16_t cost; // Сглаженное время отрисовки зоны, в тактах таймера (по 16 мкс)
+} Zone;
+
+extern Zone zones[MAX_ZONES];
+extern uint8_t zones_count;
+
+/* Сбрасывает загруженное описание зон: при следующем zones_start или zones_render оно будет перечитано из EEPROM, 
+ * лента очищена, а эффекты во всех зонах запущены заново. Вызывается после всего, что портит mem или меняет раскладку зон */
+void zones_invalidate();
+
+/* Заменяет описание зон одной зоной на всю ленту с постоянным эффектом ef и готовит её к отрисовке (для замеров, см. bench_effect).
+ * Чтобы вернуться к описанию из EEPROM, нужно вызвать zones_invalidate */
+void zones_single(uint8_t ef);
+
+/* Подготавливает зоны к отрисовке. ef - эффект, который должен запуститься в зонах со сменой эффектов */
+void zones_start(uint8_t ef);
+
+/* Отрисовывает в mem.leds очередной кадр всех зон, которым пора обновиться.
+ * Если суммарное время отрисовки не укладывается в кадр, часть зон откладывается на следующий кадр */
+void zones_render();
+
+/* Вызывается эффектом, которому нечего показывать в зоне z: зона гасится, а если в ней сменяются эффекты - запускается следующий */
+void zone_skip(EffectZone * z);
+
+#endif /* ZONES_H_ */